@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "xpipe/Pipeline.h"
+#include "xpipe/IndexSequence.h"
+#include "xpipe/inner/kernels.h"
+#include "xpipe/stage/CopyOf.h"
+#include "xpipe/stage/Delay.h"
+#include "xpipe/stage/SequenceOf.h"
+
+namespace xpipe
+{
+    namespace bench
+    {
+        using Clock = std::chrono::steady_clock;
+        // values carry the time they were produced at
+        using Stamp = std::int64_t;
+
+        const std::size_t VALUE_COUNT = 10000;
+
+        Stamp now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now().time_since_epoch()).count();
+        }
+
+        class StampSource
+        {
+        public:
+            explicit StampSource(std::size_t count)
+                :left(count)
+            {}
+
+            bool operator()(Inlet<Stamp> &inlet)
+            {
+                if(left == 0)
+                    return false;
+                --left;
+                inlet.push(now());
+                return true;
+            }
+
+        private:
+            std::size_t left;
+        };
+
+        class Latencies
+        {
+        public:
+            void record(Stamp stamp)
+            {
+                values.push_back(now() - stamp);
+            }
+
+            // elements per second and per element latency percentiles
+            void report(benchmark::State &state)
+            {
+                state.SetItemsProcessed(values.size());
+                if(values.empty())
+                    return;
+                std::sort(std::begin(values), std::end(values));
+                state.counters["p50_ns"] = percentile(0.5);
+                state.counters["p99_ns"] = percentile(0.99);
+            }
+
+        private:
+            double percentile(double p) const
+            {
+                const auto idx = static_cast<std::size_t>(
+                    p*(values.size() - 1));
+                return static_cast<double>(values[idx]);
+            }
+
+        private:
+            std::vector<Stamp> values;
+        };
+
+        struct Forward
+        {
+            bool operator()(Stamp v, Inlet<Stamp> &inlet) const
+            {
+                inlet.push(v);
+                return true;
+            }
+        };
+
+        PipelineOptions withThreads(const benchmark::State &state,
+            std::size_t arg)
+        {
+            PipelineOptions options;
+            options.threadCount = static_cast<std::size_t>(
+                state.range(static_cast<int>(arg)));
+            return options;
+        }
+
+        InStage<Stamp> recordTo(Latencies &latencies)
+        {
+            return sink([&latencies](Stamp v){
+                    latencies.record(v);
+                    return true;
+                });
+        }
+
+        void chain(benchmark::State &state)
+        {
+            const auto length = static_cast<std::size_t>(state.range(0));
+            Latencies latencies;
+            while(state.KeepRunning())
+            {
+                auto stages = map(Forward());
+                for(std::size_t i = 1; i < length; ++i)
+                    stages = stages>>map(Forward());
+                auto f = source(StampSource(VALUE_COUNT))>>stages
+                    >>recordTo(latencies);
+                Pipeline(f, withThreads(state, 1)).run();
+            }
+            latencies.report(state);
+        }
+
+        // latency of a short chain under each wait strategy
+        void chainWaiting(benchmark::State &state)
+        {
+            Latencies latencies;
+            PipelineOptions options;
+            options.threadCount = 2;
+            options.waiting = static_cast<WaitStrategy>(state.range(0));
+            while(state.KeepRunning())
+            {
+                auto f = source(StampSource(VALUE_COUNT))>>map(Forward())
+                    >>map(Forward())>>recordTo(latencies);
+                Pipeline(f, options).run();
+            }
+            latencies.report(state);
+        }
+
+        template<std::size_t>
+        Stage<Stamp, Stamp> forwardStage()
+        {
+            return map(Forward());
+        }
+
+        template<std::size_t... Is>
+        Stage<Stamp, Stamp> fanOut(IndexSequence<Is...>)
+        {
+            return anyFrom(parmap(forwardStage<Is>()...));
+        }
+
+        template<std::size_t Width>
+        void parmapFanOut(benchmark::State &state)
+        {
+            Latencies latencies;
+            while(state.KeepRunning())
+            {
+                auto f = source(StampSource(VALUE_COUNT))>>
+                    fanOut(MakeIndexSequence<Width>())>>recordTo(latencies);
+                Pipeline(f, withThreads(state, 0)).run();
+            }
+            latencies.report(state);
+        }
+
+        void allJoin(benchmark::State &state)
+        {
+            Latencies latencies;
+            while(state.KeepRunning())
+            {
+                auto f =
+                    (source(StampSource(VALUE_COUNT)) &&
+                        source(StampSource(VALUE_COUNT)))
+                    >>sink([&latencies](const std::tuple<Stamp, Stamp> &v){
+                            latencies.record(std::min(
+                                    std::get<0>(v), std::get<1>(v)));
+                            return true;
+                        });
+                Pipeline(f, withThreads(state, 0)).run();
+            }
+            latencies.report(state);
+        }
+
+        void anyMerge(benchmark::State &state)
+        {
+            Latencies latencies;
+            while(state.KeepRunning())
+            {
+                auto f =
+                    (source(StampSource(VALUE_COUNT/2)) ||
+                        source(StampSource(VALUE_COUNT/2)))
+                    >>recordTo(latencies);
+                Pipeline(f, withThreads(state, 0)).run();
+            }
+            latencies.report(state);
+        }
+
+        void seqConcat(benchmark::State &state)
+        {
+            Latencies latencies;
+            while(state.KeepRunning())
+            {
+                auto f =
+                    seq(source(StampSource(VALUE_COUNT/2)),
+                        source(StampSource(VALUE_COUNT/2)))
+                    >>recordTo(latencies);
+                Pipeline(f, withThreads(state, 0)).run();
+            }
+            latencies.report(state);
+        }
+
+        void multimapCopy(benchmark::State &state)
+        {
+            Latencies latencies;
+            while(state.KeepRunning())
+            {
+                auto r = source(StampSource(VALUE_COUNT))>>
+                    multimap(stage::CopyOf<Stamp, 2>());
+                r.get<0>()>>recordTo(latencies);
+                r.get<1>()>>sink([](Stamp){return true;});
+                Pipeline(r.get<0>(), withThreads(state, 0)).run();
+            }
+            latencies.report(state);
+        }
+
+        void fibonacciCycle(benchmark::State &state)
+        {
+            const std::size_t sz = 80;
+            std::size_t count = 0;
+            while(state.KeepRunning())
+            {
+                std::vector<std::uint64_t> fib;
+                auto f = map(
+                    [](const std::tuple<std::uint64_t, std::uint64_t> &val,
+                        Inlet<std::uint64_t> &inlet){
+                        inlet.push(std::get<0>(val) + std::get<1>(val));
+                        return true;
+                    });
+                auto r = seq(source(
+                        stage::SequenceOf<std::uint64_t>{1, 1}), f)>>
+                    multimap(stage::CopyOf<std::uint64_t, 2>());
+                r.get<0>()>>map(stage::Delay<std::uint64_t, 2>())>>f;
+                r.get<1>()>>sink([&fib, sz](std::uint64_t v){
+                        fib.push_back(v);
+                        return fib.size() < sz;
+                    });
+                Pipeline(f, withThreads(state, 0)).run();
+                count += fib.size();
+            }
+            state.SetItemsProcessed(count);
+        }
+
+        // the kernels alone, over values that fit the cache
+        void affineKernel(benchmark::State &state)
+        {
+            namespace kernels = inner::kernels;
+            kernels::setIsa(static_cast<kernels::Isa>(state.range(0)));
+            std::vector<float> values(4096, 1.0f);
+            while(state.KeepRunning())
+            {
+                kernels::affine(values.data(), values.data(), values.size(),
+                    0.5f, 0.5f);
+                benchmark::DoNotOptimize(values.data());
+            }
+            state.counters["isa"] =
+                static_cast<double>(kernels::activeIsa());
+            state.SetItemsProcessed(state.iterations()*values.size());
+            kernels::setIsa(kernels::supportedIsa());
+        }
+
+        BENCHMARK(chain)
+            ->ArgNames({"length", "threads"})
+            ->ArgsProduct({{1, 4, 16, 64}, {1, 2, 4}})
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        BENCHMARK(chainWaiting)
+            ->ArgName("waiting")->Arg(0)->Arg(1)->Arg(2)->Arg(3)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        BENCHMARK_TEMPLATE(parmapFanOut, 1)
+            ->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        BENCHMARK_TEMPLATE(parmapFanOut, 4)
+            ->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        BENCHMARK_TEMPLATE(parmapFanOut, 16)
+            ->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        BENCHMARK_TEMPLATE(parmapFanOut, 64)
+            ->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        BENCHMARK(allJoin)
+            ->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        BENCHMARK(anyMerge)
+            ->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        BENCHMARK(seqConcat)
+            ->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        BENCHMARK(multimapCopy)
+            ->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)
+            ->Unit(benchmark::kMillisecond)->UseRealTime();
+        BENCHMARK(fibonacciCycle)
+            ->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)
+            ->Unit(benchmark::kMicrosecond)->UseRealTime();
+        BENCHMARK(affineKernel)
+            ->ArgName("isa")->Arg(0)->Arg(1)->Arg(2);
+    }
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,72 @@
+#ifndef XPIPE_CAPACITY_H
+#define XPIPE_CAPACITY_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+
+namespace xpipe
+{
+    // limit of the output queue of a stage, producers are not run
+    // while the queue is at the limit
+    class Capacity
+    {
+    public:
+        Capacity()
+            :unit(Unit::None), value(0)
+        {}
+
+        static Capacity elements(std::size_t count)
+        {
+            if(count == 0)
+                throw std::invalid_argument("capacity is 0");
+            return Capacity(Unit::Elements, count);
+        }
+
+        // size/sizeof of the elements, what the elements own (strings,
+        // vectors) is not counted so it does not bound their memory
+        static Capacity sizeofBytes(std::size_t size)
+        {
+            if(size == 0)
+                throw std::invalid_argument("capacity is 0");
+            return Capacity(Unit::SizeofBytes, size);
+        }
+
+        bool isSet() const
+        {
+            return unit != Unit::None;
+        }
+
+        std::size_t elementLimit(std::size_t elementSize) const
+        {
+            switch(unit)
+            {
+            case Unit::Elements:
+                return value;
+            case Unit::SizeofBytes:
+                return std::max<std::size_t>(1, value/elementSize);
+            default:
+                throw std::logic_error("capacity is not set");
+            }
+        }
+
+    private:
+        enum class Unit
+        {
+            None,
+            Elements,
+            SizeofBytes
+        };
+
+    private:
+        Capacity(Unit unit, std::size_t value)
+            :unit(unit), value(value)
+        {}
+
+    private:
+        Unit unit;
+        std::size_t value;
+    };
+}
+
+#endif
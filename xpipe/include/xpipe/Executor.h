@@ -0,0 +1,52 @@
+#ifndef XPIPE_EXECUTOR_H
+#define XPIPE_EXECUTOR_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace xpipe
+{
+    // long-lived threads which pipelines sharing the executor run their
+    // workers on instead of spawning threads per run, a worker gives its
+    // thread back when it has nothing to do and is submitted again once
+    // its run has a task ready
+    class Executor
+    {
+    public:
+        explicit Executor(
+            std::size_t threadCount = std::thread::hardware_concurrency());
+        // runs the jobs already submitted before joining the threads
+        ~Executor();
+
+        void execute(std::function<void()> job);
+
+        std::size_t getThreadCount() const
+        {
+            return threads.size();
+        }
+
+        Executor(const Executor&) = delete;
+        Executor &operator=(const Executor&) = delete;
+
+    private:
+        using JobQueue = std::deque<std::function<void()>>;
+        using ThreadCol = std::vector<std::thread>;
+
+    private:
+        void work();
+
+    private:
+        std::mutex mutex;
+        std::condition_variable cond;
+        JobQueue jobs;
+        bool stopping;
+        ThreadCol threads;
+    };
+}
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef XPIPE_INLET_H
 #define XPIPE_INLET_H
 
+#include <cstddef>
+#include <utility>
+
 namespace xpipe
 {
     template<typename T>
@@ -9,6 +12,13 @@ namespace xpipe
     public:
         virtual ~Inlet() = default;
         virtual void push(T value) = 0;
+
+        // values are moved from
+        virtual void pushBatch(T *values, std::size_t count)
+        {
+            for(std::size_t i = 0; i < count; ++i)
+                push(std::move(values[i]));
+        }
     };
 }
 
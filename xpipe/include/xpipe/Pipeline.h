@@ -2,13 +2,21 @@
 #define XPIPE_PIPELINE_H
 
 #include <vector>
+#include <atomic>
 #include <thread>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <string>
 #include <memory>
 #include <cstddef>
 #include <tuple>
 #include <utility>
 #include <tuple>
 
+#include "xpipe/PipelineOptions.h"
+#include "xpipe/Statistics.h"
 #include "xpipe/Runnable.h"
 #include "xpipe/Stage.h"
 #include "xpipe/Functional.h"
@@ -29,41 +37,111 @@
 namespace xpipe
 {
     class Scheduler;
+    class Executor;
 
     class Pipeline
     {
     public:
         Pipeline(const BaseStage &stages);
         Pipeline(const BaseStage &stages, std::size_t threadCount);
+        Pipeline(const BaseStage &stages, const PipelineOptions &options);
         ~Pipeline();
 
         void run();
+        // runs on the executor or on a separate thread, stop() cancels
+        // the run, the destructor waits for it to end, on the executor the
+        // run holds no thread while it has nothing to do
+        std::future<void> runAsync();
         void stop();
 
+        // counters of the tasks, empty unless enabled in the options,
+        // may be called while the pipeline runs
+        PipelineStatistics statistics() const;
+
         Pipeline(const Pipeline&) = delete;
         Pipeline &operator=(const Pipeline&) = delete;
 
     private:
+        // first exception thrown by a stage, the run is stopped on it
+        struct Failure
+        {
+            std::mutex mutex;
+            std::exception_ptr error;
+        };
+
         class Routine
         {
         public:
-            Routine(Scheduler &scheduler)
-                :scheduler(&scheduler)
+            // -1 for a worker that is not pinned
+            Routine(Scheduler &scheduler, std::size_t worker,
+                Failure &failure, int cpu = -1)
+                :scheduler(&scheduler), worker(worker), failure(&failure),
+                cpu(cpu)
             {}
 
             void operator()();
+            // runs the ready tasks without waiting, true once the worker
+            // is parked and false once the run is over
+            bool poll();
+
+        private:
+            void loop();
+            void runTask(inner::Task *task);
+            // of the current exception
+            void fail();
 
         private:
             Scheduler *scheduler;
+            std::size_t worker;
+            Failure *failure;
+            int cpu;
+        };
+
+        // the workers of a run on the executor
+        struct ExecutorRun
+        {
+            std::promise<void> promise;
+            // the workers that have not seen the end of the run
+            std::atomic<std::size_t> active;
+            bool async;
         };
 
         using ThreadCol = std::vector<std::shared_ptr<std::thread>>;
 
+    private:
+        int cpuOf(std::size_t worker) const;
+        // of the workers from first on
+        void startThreads(std::size_t first);
+        void joinThreads();
+        void startRun();
+        // throws the failure of the run
+        void endRun();
+        std::future<void> runOnExecutor(bool async);
+        // a worker of the current run on the executor, the last one to see
+        // the end of the run completes it
+        void work(std::shared_ptr<ExecutorRun> run, std::size_t worker);
+        void writeTrace();
+        void beginAsync();
+        void endAsync();
+        void waitAsync();
+
     private:
         std::size_t threadCount;
+        // with the calling thread and the threads of the groups
+        std::size_t workerCount;
+        std::shared_ptr<Executor> executor;
+        std::string tracePath;
+        // indexed by the worker, empty unless pinned
+        std::vector<int> workerCpus;
         inner::graphptr::NodePointer<inner::Node> node;
         std::unique_ptr<Scheduler> scheduler;
         ThreadCol threads;
+        Failure failure;
+        std::shared_ptr<ExecutorRun> executorRun;
+        std::thread asyncThread;
+        std::mutex asyncMutex;
+        std::condition_variable asyncCond;
+        bool asyncRunning;
     };
 }
 
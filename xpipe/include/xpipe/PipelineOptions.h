@@ -0,0 +1,66 @@
+#ifndef XPIPE_PIPELINEOPTIONS_H
+#define XPIPE_PIPELINEOPTIONS_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "xpipe/Capacity.h"
+
+namespace xpipe
+{
+    class Executor;
+
+    enum class SchedulingMode
+    {
+        // one ready queue shared by all workers
+        Shared,
+        // ready queue per worker, idle workers steal from the others
+        WorkStealing
+    };
+
+    // what the workers do while there is nothing to run, spinning trades
+    // cpu time for the latency of picking up new work as the workers
+    // spinning are not woken through the kernel
+    enum class WaitStrategy
+    {
+        // sleep at once
+        Blocking,
+        // spin and never sleep, each worker keeps a cpu busy
+        BusySpin,
+        // spin for a while, then yield the cpu between the checks
+        SpinYield,
+        // spin for a time adapted to how soon the work has come before
+        // and sleep after it
+        SpinPark
+    };
+
+    struct PipelineOptions
+    {
+        std::size_t threadCount = std::thread::hardware_concurrency();
+        SchedulingMode scheduling = SchedulingMode::Shared;
+        WaitStrategy waiting = WaitStrategy::Blocking;
+        // used by stages without their own capacity
+        Capacity capacity = Capacity::elements(6);
+        // runs threadCount + 1 workers as its jobs, the calling thread
+        // only waits for them, the workers do not spin while they wait,
+        // without it the threads are spawned on each run
+        std::shared_ptr<Executor> executor;
+        // pins the workers to the cpus, spread over the NUMA nodes in turn,
+        // so the stages can be placed on a node, the calling thread is
+        // pinned for the run as well, ignored with an executor
+        bool pinWorkers = false;
+        // threads besides the workers, by the group name, that run only
+        // the stages of their group
+        std::map<std::string, std::size_t> threadGroups;
+        // collect the counters reported by Pipeline::statistics()
+        bool statistics = false;
+        // file the Chrome trace of the scheduler activity is written to
+        // at the end of each run, empty for no tracing
+        std::string tracePath;
+    };
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef XPIPE_REACTOR_H
+#define XPIPE_REACTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "xpipe/Runnable.h"
+
+namespace xpipe
+{
+    // one thread completing the reads and sends of many descriptors, with
+    // io_uring when the kernel supports it and epoll otherwise
+    class Reactor
+    {
+    public:
+        enum class Backend
+        {
+            Auto,
+            IoUring,
+            Epoll
+        };
+
+        // gets the number of bytes read or sent, 0 at the end of the input
+        // or a negated errno value
+        class Handler
+        {
+        public:
+            virtual ~Handler() = default;
+            virtual void complete(long result) = 0;
+        };
+
+        // identifies a request for its cancellation, unique for the reactor
+        using Request = std::uint64_t;
+
+        class Impl;
+
+    public:
+        explicit Reactor(Backend backend = Backend::Auto);
+        // the pending reads have to be completed or cancelled
+        ~Reactor();
+
+        Reactor(const Reactor&) = delete;
+        Reactor &operator=(const Reactor&) = delete;
+
+        Backend getBackend() const;
+
+        // the handler is called on the reactor thread, it has at most one
+        // request at a time, the buffer is used until then, the errors of
+        // the reactor after the request is started are given to the handler,
+        // a descriptor has at most one request at a time
+        Request read(int fd, char *buffer, std::size_t size,
+            Handler &handler);
+        // sends a part of the buffer to a socket once it has room, the same
+        // as read otherwise
+        Request send(int fd, const char *buffer, std::size_t size,
+            Handler &handler);
+        // sends a part of the buffers in their order, the vectors are used
+        // until the handler is called as well
+        Request send(int fd, const iovec *buffers, std::size_t count,
+            Handler &handler);
+        // the request completes with -ECANCELED unless it has already got
+        // its result, a request that is over is left alone
+        void cancel(Request request);
+
+    private:
+        std::unique_ptr<Impl> impl;
+        std::thread thread;
+    };
+
+    // pushes what is read from a descriptor (not owned) and an empty buffer
+    // at its end, at most bufferCount buffers are read ahead of the
+    // pipeline
+    class ReadRunnable: public Runnable<std::vector<char>>,
+        private Reactor::Handler
+    {
+    public:
+        ReadRunnable(Reactor &reactor, int fd,
+            std::size_t bufferSize = 64*1024, std::size_t bufferCount = 4);
+
+        void init(RunnableInlet<std::vector<char>> &inlet) override;
+        void destroy() override;
+        bool canRun() override;
+        bool run() override;
+
+    private:
+        using BufferQueue = std::deque<std::vector<char>>;
+
+    private:
+        void complete(long result) override;
+        // a read that can not be started ends the input with its error
+        void submit();
+
+    private:
+        Reactor &reactor;
+        int fd;
+        std::size_t bufferSize;
+        std::size_t bufferCount;
+        RunnableInlet<std::vector<char>> *inlet;
+        std::vector<char> buffer;
+        std::mutex mutex;
+        std::condition_variable cond;
+        BufferQueue ready;
+        // the last read started
+        Reactor::Request request;
+        bool inFlight;
+        bool completing;
+        bool ended;
+        bool stopping;
+        int error;
+    };
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef XPIPE_RUNNABLESINK_H
+#define XPIPE_RUNNABLESINK_H
+
+#include <vector>
+
+namespace xpipe
+{
+    class RunnableOutlet
+    {
+    public:
+        // canRun of the sink may have become true
+        virtual void notifyCanRun() = 0;
+
+    protected:
+        ~RunnableOutlet() = default;
+    };
+
+    // sink that is not run while it can not take the values, it notifies
+    // the outlet instead of waiting on a worker
+    template<typename T>
+    class RunnableSink
+    {
+    public:
+        virtual ~RunnableSink() = default;
+
+        virtual void init(RunnableOutlet &outlet) = 0;
+        virtual void destroy() = 0;
+        virtual bool canRun() = 0;
+        // takes the values from the front it can, the rest are given again,
+        // they are empty at the end of the input and it is run until it
+        // returns false, false stops the stage
+        virtual bool run(std::vector<T> &values) = 0;
+    };
+}
+
+#endif
@@ -11,6 +11,8 @@
 
 #include "xpipe/Functional.h"
 #include "xpipe/Runnable.h"
+#include "xpipe/RunnableSink.h"
+#include "xpipe/StageOptions.h"
 #include "xpipe/inner/Node.h"
 #include "xpipe/inner/InTypedNode.h"
 #include "xpipe/inner/OutTypedNode.h"
@@ -32,8 +34,13 @@
 #include "xpipe/inner/SeqNode.h"
 #include "xpipe/inner/InterruptTaskNode.h"
 #include "xpipe/inner/SinkTaskNode.h"
+#include "xpipe/inner/BatchProcTaskNode.h"
+#include "xpipe/inner/BatchSinkTaskNode.h"
+#include "xpipe/inner/RunnableSinkTaskNode.h"
 #include "xpipe/inner/MultiOutConsumerNode.h"
 #include "xpipe/inner/ParNode.h"
+#include "xpipe/inner/OrderedNode.h"
+#include "xpipe/inner/PartitionTaskNode.h"
 #include "xpipe/inner/graphptr.h"
 
 namespace xpipe
@@ -188,36 +195,120 @@ namespace xpipe
                     stage.template getOutTask<Is>().link(child)),nullptr)...};
             return OutStage<Out>(child);
         }
+
+        template<typename In, typename Out, class F>
+        Stage<In, Out> parmap(std::size_t count, F &factory,
+            const Stage<In, Out> &first)
+        {
+            auto parent = graphptr::make_node<ParNode<In>>();
+            auto child = graphptr::make_node<OrNode<Out>>();
+            typename ParNode<In>::NodePtrCol children;
+            typename OrNode<Out>::NodePtrCol prevs;
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                const auto replica = i == 0?first:Stage<In, Out>(factory());
+                auto out = replica.template getOutTask<0>();
+                children.push_back(parent.link(out));
+                replica.getInTask()->setParent(out.link(parent));
+                prevs.push_back(child.link(out));
+                out->setChild(out.link(child));
+            }
+            parent->setChildren(children);
+            child->setParents(prevs);
+            return Stage<In, Out>(child, parent);
+        }
+
+        template<typename In, typename Out, class K, class F>
+        Stage<In, Out> partitionBy(K key, std::size_t count, F &factory,
+            const Stage<In, Out> &first, const StageOptions &options)
+        {
+            auto parent = graphptr::make_node<PartitionTaskNode<In, K>>(
+                std::move(key), count, options);
+            auto child = graphptr::make_node<OrNode<Out>>();
+            std::vector<graphptr::LinkPointer<Node>> children;
+            typename OrNode<Out>::NodePtrCol prevs;
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                const auto replica = i == 0?first:Stage<In, Out>(factory());
+                auto consumer =
+                    graphptr::make_node<PartitionConsumerNode<In>>(i);
+                consumer->setParent(consumer.link(parent));
+                children.push_back(parent.link(consumer));
+                linkNodes(graphptr::NodePointer<OutTypedNode<In>>(consumer),
+                    replica.getInTask());
+                auto out = replica.template getOutTask<0>();
+                prevs.push_back(child.link(out));
+                out->setChild(out.link(child));
+            }
+            parent->setChildren(children);
+            child->setParents(prevs);
+            return Stage<In, Out>(child, parent);
+        }
     }
 
     template<class S>
-    OutStage<typename inner::SourceStageTraits<S>::OutType> source(S &&stage)
+    OutStage<typename inner::SourceStageTraits<S>::OutType> source(S &&stage,
+        const StageOptions &options = StageOptions())
     {
         return OutStage<typename inner::SourceStageTraits<S>::OutType>(
             inner::graphptr::make_node<inner::FromTaskNode<S>>(
-                std::forward<S>(stage)));
+                std::forward<S>(stage), options));
     }
 
     template<class S>
-    InStage<typename inner::SinkStageTraits<S>::InType> sink(S &&stage)
+    InStage<typename inner::SinkStageTraits<S>::InType> sink(S &&stage,
+        const StageOptions &options = StageOptions())
     {
         return InStage<typename inner::SinkStageTraits<S>::InType>(
             inner::graphptr::make_node<inner::SinkTaskNode<S>>(
-                std::forward<S>(stage)));
+                std::forward<S>(stage), options));
     }
 
     template<class S>
     Stage<typename inner::StageTraits<S>::InType,
-        typename inner::StageTraits<S>::OutType> map(S &&stage)
+        typename inner::StageTraits<S>::OutType> map(S &&stage,
+        const StageOptions &options = StageOptions())
     {
         using DS = typename std::decay<S>::type;
         auto node = inner::graphptr::make_node<inner::ProcTaskNode<DS>>(
-            std::forward<S>(stage));
+            std::forward<S>(stage), options);
         return Stage<typename inner::StageTraits<S>::InType,
                typename inner::StageTraits<S>::OutType>(
                    node, node);
     }
 
+    // the stage takes a vector of up to maxSize values, a stage with
+    // void finish(Inlet<Out>&) is also called once at the end of its input
+    template<class S>
+    Stage<typename inner::BatchStageTraits<S>::InType,
+        typename inner::BatchStageTraits<S>::OutType> batchMap(
+        std::size_t maxSize, S &&stage,
+        const StageOptions &options = StageOptions())
+    {
+        if(maxSize == 0)
+            throw std::invalid_argument("batch size is 0");
+        using DS = typename std::decay<S>::type;
+        auto node = inner::graphptr::make_node<inner::BatchProcTaskNode<DS>>(
+            maxSize, std::forward<S>(stage), options);
+        return Stage<typename inner::BatchStageTraits<S>::InType,
+               typename inner::BatchStageTraits<S>::OutType>(
+                   node, node);
+    }
+
+    // the stage takes a vector of up to maxSize values
+    template<class S>
+    InStage<typename inner::BatchSinkStageTraits<S>::InType> batchSink(
+        std::size_t maxSize, S &&stage,
+        const StageOptions &options = StageOptions())
+    {
+        if(maxSize == 0)
+            throw std::invalid_argument("batch size is 0");
+        using DS = typename std::decay<S>::type;
+        return InStage<typename inner::BatchSinkStageTraits<S>::InType>(
+            inner::graphptr::make_node<inner::BatchSinkTaskNode<DS>>(
+                maxSize, std::forward<S>(stage), options));
+    }
+
     template<typename Out, typename... Outs>
     OutStage<Out> any(
         const OutStage<Out> &stage,
@@ -288,11 +379,25 @@ namespace xpipe
     }
 
     template<class Out>
-    OutStage<Out> use(std::unique_ptr<Runnable<Out>> runnable)
+    OutStage<Out> use(std::unique_ptr<Runnable<Out>> runnable,
+        const StageOptions &options = StageOptions())
     {
         return OutStage<Out>(
             inner::graphptr::make_node<inner::InterruptTaskNode<Out>>(
-                std::move(runnable)));
+                std::move(runnable), options));
+    }
+
+    // the runnable takes a vector of up to maxSize values
+    template<class In>
+    InStage<In> use(std::size_t maxSize,
+        std::unique_ptr<RunnableSink<In>> runnable,
+        const StageOptions &options = StageOptions())
+    {
+        if(maxSize == 0)
+            throw std::invalid_argument("batch size is 0");
+        return InStage<In>(
+            inner::graphptr::make_node<inner::RunnableSinkTaskNode<In>>(
+                maxSize, std::move(runnable), options));
     }
 
     template<typename IN, typename MID, typename... OUT>
@@ -334,9 +439,11 @@ namespace xpipe
     }
 
     template<class S>
-    typename inner::MultiOutStageTraits<Stage, S>::FuncType multimap(S stage)
+    typename inner::MultiOutStageTraits<Stage, S>::FuncType multimap(S stage,
+        const StageOptions &options = StageOptions())
     {
-        auto node = inner::graphptr::make_node<inner::MultiProcTask<S>>(stage);
+        auto node = inner::graphptr::make_node<inner::MultiProcTask<S>>(
+            stage, options);
         return makeMultiConsumers(
             inner::graphptr::NodePointer<inner::InTypedNode<
                 typename inner::MultiOutStageTraits<
@@ -360,6 +467,63 @@ namespace xpipe
             std::make_tuple(stages.template getOutTask<0>()...),
             parent);
     }
+
+    // runs count stages made by the factory in parallel, each call to the
+    // factory has to build new stages, unlike the parmap of listed stages
+    // the outputs are already merged as anyFrom would since their number
+    // is not known at compile time
+    template<class F>
+    typename std::result_of<F()>::type parmap(std::size_t count, F factory)
+    {
+        if(count == 0)
+            throw std::invalid_argument("parallelism is 0");
+        return inner::parmap(count, factory, factory());
+    }
+
+    // runs count stages made by the factory in parallel, the values with
+    // equal keys are always handled by the same stage
+    template<class K, class F>
+    typename std::result_of<F()>::type partitionBy(K key, std::size_t count,
+        F factory, const StageOptions &options = StageOptions())
+    {
+        if(count == 0)
+            throw std::invalid_argument("parallelism is 0");
+        return inner::partitionBy(std::move(key), count, factory, factory(),
+            options);
+    }
+
+    // runs count copies of the stage in parallel, the outputs keep the
+    // order of the inputs
+    template<class S>
+    Stage<typename inner::StageTraits<S>::InType,
+        typename inner::StageTraits<S>::OutType> parmapOrdered(
+        std::size_t count, const S &stage,
+        const StageOptions &options = StageOptions())
+    {
+        using In = typename inner::StageTraits<S>::InType;
+        using Out = typename inner::StageTraits<S>::OutType;
+        using DS = typename std::decay<S>::type;
+        using Tagged = std::pair<std::size_t, In>;
+        if(count == 0)
+            throw std::invalid_argument("parallelism is 0");
+        auto parent = inner::graphptr::make_node<inner::ParNode<Tagged>>();
+        auto child = inner::graphptr::make_node<inner::OrderedNode<Out>>();
+        typename inner::ParNode<Tagged>::NodePtrCol children;
+        typename inner::OrderedNode<Out>::NodePtrCol groups;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            auto worker = map(inner::GroupingStage<DS>(stage), options);
+            auto out = worker.template getOutTask<0>();
+            children.push_back(parent.link(out));
+            worker.getInTask()->setParent(out.link(parent));
+            groups.push_back(child.link(out));
+            out->setChild(out.link(child));
+        }
+        parent->setChildren(children);
+        child->setParents(groups);
+        return combine(map(inner::SequenceTagger<In>()),
+            Stage<Tagged, Out>(child, parent));
+    }
 }
 
 template<class OUT>
@@ -0,0 +1,98 @@
+#ifndef XPIPE_STAGEOPTIONS_H
+#define XPIPE_STAGEOPTIONS_H
+
+#include <string>
+
+#include "xpipe/Capacity.h"
+
+namespace xpipe
+{
+    class StageOptions
+    {
+    public:
+        StageOptions()
+            :capacity(), name(), node(-1), threadGroup(),
+            dedicatedThread(false)
+        {}
+
+        StageOptions(const Capacity &capacity)
+            :capacity(capacity), name(), node(-1), threadGroup(),
+            dedicatedThread(false)
+        {}
+
+        StageOptions &setCapacity(const Capacity &capacity)
+        {
+            this->capacity = capacity;
+            return *this;
+        }
+
+        const Capacity &getCapacity() const
+        {
+            return capacity;
+        }
+
+        // reported in the statistics
+        StageOptions &setName(const std::string &name)
+        {
+            this->name = name;
+            return *this;
+        }
+
+        const std::string &getName() const
+        {
+            return name;
+        }
+
+        // the stage is run only by the workers of the NUMA node and its
+        // queue is allocated there, ignored unless the workers are pinned
+        // and some are on the node
+        StageOptions &setNode(int node)
+        {
+            this->node = node;
+            return *this;
+        }
+
+        // -1 for any node
+        int getNode() const
+        {
+            return node;
+        }
+
+        // the stage is run only by the threads of the group, one of the
+        // PipelineOptions::threadGroups, and they run nothing else
+        StageOptions &setThreadGroup(const std::string &group)
+        {
+            threadGroup = group;
+            dedicatedThread = false;
+            return *this;
+        }
+
+        // empty for the shared workers
+        const std::string &getThreadGroup() const
+        {
+            return threadGroup;
+        }
+
+        // the stage gets a thread of its own
+        StageOptions &setDedicatedThread()
+        {
+            threadGroup.clear();
+            dedicatedThread = true;
+            return *this;
+        }
+
+        bool hasDedicatedThread() const
+        {
+            return dedicatedThread;
+        }
+
+    private:
+        Capacity capacity;
+        std::string name;
+        int node;
+        std::string threadGroup;
+        bool dedicatedThread;
+    };
+}
+
+#endif
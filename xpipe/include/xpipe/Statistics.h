@@ -0,0 +1,29 @@
+#ifndef XPIPE_STATISTICS_H
+#define XPIPE_STATISTICS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xpipe
+{
+    struct TaskStatistics
+    {
+        // name from the stage options
+        std::string name;
+        std::uint64_t valuesIn = 0;
+        std::uint64_t valuesOut = 0;
+        std::uint64_t runs = 0;
+        std::chrono::nanoseconds busyTime = std::chrono::nanoseconds(0);
+        // time between becoming ready and being taken by a worker
+        std::chrono::nanoseconds readyWaitTime = std::chrono::nanoseconds(0);
+        // for each output queue, its pushes by its depth after the push,
+        // bucket 0 is for depth 0, bucket i for depths in [2^(i-1), 2^i)
+        std::vector<std::vector<std::uint64_t>> queueDepth;
+    };
+
+    using PipelineStatistics = std::vector<TaskStatistics>;
+}
+
+#endif
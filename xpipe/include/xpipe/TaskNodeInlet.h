@@ -21,6 +21,7 @@ namespace xpipe
         friend class inner::BaseTaskNode;
     public:
         void push(T value) override;
+        void pushBatch(T *values, std::size_t count) override;
 
     protected:
         TaskNodeInlet(inner::TaskNode<T> &node)
@@ -41,6 +42,12 @@ namespace xpipe
     {
         node.push(std::move(value));
     }
+
+    template<typename T>
+    void TaskNodeInlet<T>::pushBatch(T *values, std::size_t count)
+    {
+        node.pushBatch(values, count);
+    }
 }
 
 #endif
@@ -1,15 +1,19 @@
 #ifndef XPIPE_INNER_ASYNCQUEUE_H
 #define XPIPE_INNER_ASYNCQUEUE_H
 
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <deque>
+#include <vector>
+#include <memory>
 #include <functional>
 #include <algorithm>
 #include <mutex>
 #include <condition_variable>
 
 #include "xpipe/inner/Nullable.h"
+#include "xpipe/inner/SpscQueue.h"
 
 namespace xpipe
 {
@@ -20,15 +24,30 @@ namespace xpipe
         {
         public:
             AsyncQueue()
-                :queue(), queueMutex()
+                :queue(), queueMutex(), ring(), overflowSize(0)
             {
             }
 
             ~AsyncQueue();
 
-            void push(const T &value);
-            void push(T &&value);
+            // switches an empty queue to a lock-free ring, valid only while
+            // a single thread pushes and a single thread pops at a time
+            void enableRing(std::size_t capacity);
+
+            // the pushes return the size right after the values are added
+            // and the pops report what is left, readiness notifications
+            // are decided on these
+            std::size_t push(const T &value);
+            std::size_t push(T &&value);
+            // values are moved from
+            std::size_t pushBatch(T *values, std::size_t count);
             Nullable<T> tryPop();
+            Nullable<T> tryPop(std::size_t &remaining);
+            // appends at most maxCount values, returns how many
+            std::size_t tryPopBatch(std::vector<T> &values,
+                std::size_t maxCount);
+            std::size_t tryPopBatch(std::vector<T> &values,
+                std::size_t maxCount, std::size_t &remaining);
             bool empty() const;
             std::size_t size() const;
 
@@ -38,9 +57,19 @@ namespace xpipe
         private:
             using Queue = std::deque<T>;
 
+        private:
+            std::size_t pushOverflow(T &value);
+            // size seen by the single producer or consumer of the ring
+            // after its update
+            std::size_t ringSize() const;
+
         private:
             Queue queue;
             mutable std::mutex queueMutex;
+            // with the ring enabled the deque keeps what did not fit into it,
+            // the ring is not pushed to until the overflow is drained
+            std::unique_ptr<SpscQueue<T>> ring;
+            std::atomic<std::size_t> overflowSize;
         };
 
         template<typename T>
@@ -48,35 +77,136 @@ namespace xpipe
         {}
 
         template<typename T>
-        void AsyncQueue<T>::push(const T &value)
+        void AsyncQueue<T>::enableRing(std::size_t capacity)
         {
-            std::lock_guard<std::mutex> lock(queueMutex);
-            queue.push_back(value);
+            assert(empty());
+            ring.reset(new SpscQueue<T>(capacity));
         }
 
         template<typename T>
-        void AsyncQueue<T>::push(T &&value)
+        std::size_t AsyncQueue<T>::push(const T &value)
         {
+            T copy(value);
+            return push(std::move(copy));
+        }
+
+        template<typename T>
+        std::size_t AsyncQueue<T>::push(T &&value)
+        {
+            if(ring)
+            {
+                if(overflowSize == 0 && ring->tryPush(value))
+                    return ringSize();
+                return pushOverflow(value);
+            }
             std::lock_guard<std::mutex> lock(queueMutex);
             queue.push_back(std::move(value));
+            return queue.size();
+        }
+
+        template<typename T>
+        std::size_t AsyncQueue<T>::pushBatch(T *values, std::size_t count)
+        {
+            std::size_t i = 0;
+            if(ring)
+            {
+                while(i < count && overflowSize == 0 &&
+                    ring->tryPush(values[i]))
+                    ++i;
+            }
+            if(ring && i == count)
+                return ringSize();
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for(; i < count; ++i)
+            {
+                queue.push_back(std::move(values[i]));
+                if(ring)
+                    ++overflowSize;
+            }
+            return ring?ring->size() + queue.size():queue.size();
         }
 
         template<typename T>
         Nullable<T> AsyncQueue<T>::tryPop()
         {
+            std::size_t remaining = 0;
+            return tryPop(remaining);
+        }
+
+        template<typename T>
+        Nullable<T> AsyncQueue<T>::tryPop(std::size_t &remaining)
+        {
+            if(ring)
+            {
+                // read before the ring: while the overflow is not empty
+                // nothing is pushed to the ring
+                const std::size_t overflow = overflowSize;
+                auto res = ring->tryPop();
+                if(!res.isNull() || overflow == 0)
+                {
+                    remaining = ringSize();
+                    return res;
+                }
+            }
             std::lock_guard<std::mutex> lock(queueMutex);
+            Nullable<T> res;
             if(!queue.empty())
             {
-                Nullable<T> res(std::move(queue.front()));
+                res = Nullable<T>(std::move(queue.front()));
                 queue.pop_front();
-                return res;
+                if(ring)
+                    --overflowSize;
             }
-            return Nullable<T>();
+            remaining = ring?ring->size() + queue.size():queue.size();
+            return res;
+        }
+
+        template<typename T>
+        std::size_t AsyncQueue<T>::tryPopBatch(std::vector<T> &values,
+            std::size_t maxCount)
+        {
+            std::size_t remaining = 0;
+            return tryPopBatch(values, maxCount, remaining);
+        }
+
+        template<typename T>
+        std::size_t AsyncQueue<T>::tryPopBatch(std::vector<T> &values,
+            std::size_t maxCount, std::size_t &remaining)
+        {
+            std::size_t count = 0;
+            if(ring)
+            {
+                const std::size_t overflow = overflowSize;
+                for(; count < maxCount; ++count)
+                {
+                    auto value = ring->tryPop();
+                    if(value.isNull())
+                        break;
+                    values.push_back(std::move(*value));
+                }
+                if(count == maxCount || overflow == 0)
+                {
+                    remaining = ringSize();
+                    return count;
+                }
+            }
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for(; count < maxCount && !queue.empty(); ++count)
+            {
+                values.push_back(std::move(queue.front()));
+                queue.pop_front();
+                if(ring)
+                    --overflowSize;
+            }
+            remaining = ring?ring->size() + queue.size():queue.size();
+            return count;
         }
 
         template<typename T>
         bool AsyncQueue<T>::empty() const
         {
+            if(ring)
+                return overflowSize == 0 && ring->empty();
             std::lock_guard<std::mutex> lock(queueMutex);
             return queue.empty();
         }
@@ -84,9 +214,29 @@ namespace xpipe
         template<typename T>
         std::size_t AsyncQueue<T>::size() const
         {
+            if(ring)
+                return ring->size() + overflowSize;
             std::lock_guard<std::mutex> lock(queueMutex);
             return queue.size();
         }
+
+        template<typename T>
+        std::size_t AsyncQueue<T>::pushOverflow(T &value)
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(std::move(value));
+            ++overflowSize;
+            return ring->size() + queue.size();
+        }
+
+        template<typename T>
+        std::size_t AsyncQueue<T>::ringSize() const
+        {
+            // orders the update of the ring before reading the other end,
+            // pairs with the fence the scheduler puts before canRun()
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return ring->size() + overflowSize;
+        }
     }
 }
 
@@ -1,6 +1,11 @@
 #ifndef XPIPE_INNER_BASETASK_H
 #define XPIPE_INNER_BASETASK_H
 
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "xpipe/StageOptions.h"
 #include "xpipe/inner/Task.h"
 
 namespace xpipe
@@ -10,6 +15,14 @@ namespace xpipe
         class BaseTask: public Task
         {
         public:
+            explicit BaseTask(const StageOptions &options = StageOptions())
+                :name(options.getName()), node(options.getNode()),
+                threadGroup(options.getThreadGroup()),
+                dedicatedThread(options.hasDedicatedThread()), counters()
+            {}
+
+            void configure(const PipelineOptions&) override
+            {}
             void init() override
             {}
             void destroy() override
@@ -22,7 +35,53 @@ namespace xpipe
                 return oldListener;
             }
 
+            void setIndex(std::size_t index) override
+            {
+                this->index = index;
+            }
+
+            std::size_t getIndex() const override
+            {
+                return index;
+            }
+
+            const std::string &getName() const override
+            {
+                return name;
+            }
+
+            int getNode() const override
+            {
+                return node;
+            }
+
+            const std::string &getThreadGroup() const override
+            {
+                return threadGroup;
+            }
+
+            bool hasDedicatedThread() const override
+            {
+                return dedicatedThread;
+            }
+
+            void enableCounters() override
+            {
+                counters.reset(new TaskCounters(name, outputCount()));
+            }
+
+            TaskCounters *getCounters() override
+            {
+                return counters.get();
+            }
+
         protected:
+            // the number of output queues, none for sinks
+            virtual std::size_t outputCount() const
+            {
+                return 0;
+            }
+
             void notifyPush()
             {
                 if(listener != nullptr)
@@ -47,8 +106,20 @@ namespace xpipe
                     listener->notifyFinished(*this);
             }
 
+            void countIn(std::size_t count)
+            {
+                if(counters)
+                    counters->countIn(count);
+            }
+
         private:
             Task::Listener *listener = nullptr;
+            std::size_t index = 0;
+            std::string name;
+            int node;
+            std::string threadGroup;
+            bool dedicatedThread;
+            std::unique_ptr<TaskCounters> counters;
         };
     }
 }
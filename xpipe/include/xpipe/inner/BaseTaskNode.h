@@ -12,8 +12,8 @@ namespace xpipe
         class BaseTaskNode: public TaskNode<OUT>
         {
         public:
-            BaseTaskNode()
-                :inlet(*this)
+            BaseTaskNode(const StageOptions &options)
+                :TaskNode<OUT>(options), inlet(*this)
             {}
 
         protected:
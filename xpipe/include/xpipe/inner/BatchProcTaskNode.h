@@ -0,0 +1,153 @@
+#ifndef XPIPE_INNER_BATCHPROCTASKNODE_H
+#define XPIPE_INNER_BATCHPROCTASKNODE_H
+
+#include <cstddef>
+#include <cassert>
+#include <type_traits>
+#include <vector>
+
+#include "xpipe/inner/BaseTaskNode.h"
+#include "xpipe/inner/StageTraits.h"
+#include "xpipe/inner/OutTypedNode.h"
+#include "xpipe/inner/InTypedNode.h"
+
+namespace xpipe
+{
+    namespace inner
+    {
+        // passes the stage up to maxSize of the values available at once and
+        // lets it finish at the end of the input
+        template<class S>
+        class BatchProcTaskNode:
+            public BaseTaskNode<typename BatchStageTraits<S>::OutType>,
+            public InTypedNode<typename BatchStageTraits<S>::InType>
+        {
+        private:
+            using Parent = InTypedNode<typename BatchStageTraits<S>::InType>;
+            using Child = BaseTaskNode<typename BatchStageTraits<S>::OutType>;
+
+        public:
+            BatchProcTaskNode(std::size_t maxSize, S stage,
+                const StageOptions &options);
+
+            BatchProcTaskNode(const BatchProcTaskNode&) = delete;
+            BatchProcTaskNode &operator=(const BatchProcTaskNode&) = delete;
+
+            bool run() override;
+            bool canRun() override;
+            bool parentsAreDone() const override;
+            bool childrenAreFinished() const override;
+
+        protected:
+            bool shouldFinish() const;
+
+        private:
+            using HasFinish =
+                inner::HasFinish<S, typename BatchStageTraits<S>::OutType>;
+
+        private:
+            // whether the stage has still to finish before the node
+            bool finishPending() const;
+            void finishStage(std::true_type);
+            void finishStage(std::false_type)
+            {}
+
+        private:
+            S stage;
+            std::size_t maxSize;
+            typename BatchStageTraits<S>::BatchType batch;
+            bool stageFinished = !HasFinish::value;
+            volatile bool finished = false;
+        };
+
+        template<class S>
+        BatchProcTaskNode<S>::BatchProcTaskNode(std::size_t maxSize, S stage,
+            const StageOptions &options)
+            :Child(options), stage(std::move(stage)), maxSize(maxSize), batch()
+        {
+            assert(maxSize > 0);
+        }
+
+        template<class S>
+        bool BatchProcTaskNode<S>::run()
+        {
+            if(finished)
+            {
+                BatchProcTaskNode::notifyFinished();
+                return false;
+            }
+            if(shouldFinish())
+            {
+                if(finishPending())
+                {
+                    if(!BatchProcTaskNode::canPush())
+                        return false;
+                    stageFinished = true;
+                    finishStage(
+                        std::integral_constant<bool, HasFinish::value>());
+                }
+                finished = true;
+                BatchProcTaskNode::notifyFinished();
+                return false;
+            }
+            if(!BatchProcTaskNode::canPush())
+                return false;
+            batch.clear();
+            if(BatchProcTaskNode::parentTryPopBatch(batch, maxSize) > 0)
+            {
+                BatchProcTaskNode::countIn(batch.size());
+                if(!this->stage(std::move(batch),
+                        BatchProcTaskNode::getInlet()))
+                {
+                    finished = true;
+                    BatchProcTaskNode::notifyFinished();
+                    return false;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        template<class S>
+        bool BatchProcTaskNode<S>::canRun()
+        {
+            return (BatchProcTaskNode::canPush() &&
+                BatchProcTaskNode::parentCanPop()) || (shouldFinish() &&
+                (!finishPending() || BatchProcTaskNode::canPush()));
+        }
+
+        template<class S>
+        bool BatchProcTaskNode<S>::finishPending() const
+        {
+            // nothing is taken once the children are finished
+            return !stageFinished && !Child::childrenAreFinished();
+        }
+
+        template<class S>
+        void BatchProcTaskNode<S>::finishStage(std::true_type)
+        {
+            this->stage.finish(BatchProcTaskNode::getInlet());
+        }
+
+        template<class S>
+        bool BatchProcTaskNode<S>::shouldFinish() const
+        {
+            return Parent::parentsAreDone() || Child::childrenAreFinished();
+        }
+
+        template<class S>
+        bool BatchProcTaskNode<S>::parentsAreDone() const
+        {
+            return finished &&
+                BatchProcTaskNode::queueEmpty();
+        }
+
+        template<class S>
+        bool BatchProcTaskNode<S>::childrenAreFinished() const
+        {
+            return finished;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef XPIPE_INNER_BATCHSINKTASKNODE_H
+#define XPIPE_INNER_BATCHSINKTASKNODE_H
+
+#include <cstddef>
+#include <cassert>
+
+#include "xpipe/StageOptions.h"
+#include "xpipe/inner/Task.h"
+#include "xpipe/inner/BaseTask.h"
+#include "xpipe/inner/StageTraits.h"
+#include "xpipe/inner/InTypedNode.h"
+
+namespace xpipe
+{
+    namespace inner
+    {
+        // passes the stage up to maxSize of the values available at once
+        template<class S>
+        class BatchSinkTaskNode: public BaseTask,
+            public InTypedNode<typename BatchSinkStageTraits<S>::InType>
+        {
+            using Parent = InTypedNode<typename BatchSinkStageTraits<S>::InType>;
+        public:
+            BatchSinkTaskNode(std::size_t maxSize, S stage,
+                const StageOptions &options)
+                :BaseTask(options), stage(std::move(stage)),
+                maxSize(maxSize), batch(),
+                children_{}
+            {
+                assert(maxSize > 0);
+            }
+
+            BatchSinkTaskNode(const BatchSinkTaskNode&) = delete;
+            BatchSinkTaskNode &operator=(const BatchSinkTaskNode&) = delete;
+
+            const Node::NodeCol &children() const override
+            {
+                return children_;
+            }
+            void clearChildren() override
+            {
+                children_.clear();
+            }
+
+            Task *task() override
+            {
+                return this;
+            }
+
+            bool run() override;
+            bool canRun() override;
+            bool parentsAreDone() const override;
+            bool childrenAreFinished() const override
+            {
+                return finished;
+            }
+
+        protected:
+            bool shouldFinish() const;
+
+        private:
+            S stage;
+            std::size_t maxSize;
+            typename BatchSinkStageTraits<S>::BatchType batch;
+            Node::NodeCol children_;
+            bool finished = false;
+        };
+
+        template<class S>
+        bool BatchSinkTaskNode<S>::run()
+        {
+            if(finished)
+            {
+                BatchSinkTaskNode::notifyFinished();
+                return false;
+            }
+            if(shouldFinish())
+            {
+                finished = true;
+                BatchSinkTaskNode::notifyFinished();
+                return false;
+            }
+            batch.clear();
+            if(BatchSinkTaskNode::parentTryPopBatch(batch, maxSize) > 0)
+            {
+                BatchSinkTaskNode::countIn(batch.size());
+                if(!this->stage(std::move(batch)))
+                {
+                    finished = true;
+                    BatchSinkTaskNode::notifyFinished();
+                    return false;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        template<class S>
+        bool BatchSinkTaskNode<S>::canRun()
+        {
+            return BatchSinkTaskNode::parentCanPop() || shouldFinish();
+        }
+
+        template<class S>
+        bool BatchSinkTaskNode<S>::parentsAreDone() const
+        {
+            return finished;
+        }
+
+        template<class S>
+        bool BatchSinkTaskNode<S>::shouldFinish() const
+        {
+            return Parent::parentsAreDone();
+        }
+    }
+}
+
+#endif
@@ -14,8 +14,8 @@ namespace xpipe
         {
             using Child = BaseTaskNode<typename SourceStageTraits<S>::OutType>;
         public:
-            FromTaskNode(S stage)
-                :stage(std::move(stage)), parents_()
+            FromTaskNode(S stage, const StageOptions &options)
+                :Child(options), stage(std::move(stage)), parents_()
             {}
 
             FromTaskNode(const FromTaskNode&) = delete;
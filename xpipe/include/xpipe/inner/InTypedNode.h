@@ -1,7 +1,9 @@
 #ifndef XPIPE_INNER_INTYPEDNODE_H
 #define XPIPE_INNER_INTYPEDNODE_H
 
+#include <cstddef>
 #include <memory>
+#include <vector>
 
 #include "xpipe/inner/Nullable.h"
 #include "xpipe/inner/Node.h"
@@ -48,6 +50,16 @@ namespace xpipe
                 return Nullable<InType>();
             }
 
+            std::size_t parentTryPopBatch(std::vector<InType> &values,
+                std::size_t maxCount)
+            {
+                if(parent)
+                {
+                    return parent->tryPopBatch(values, maxCount);
+                }
+                return 0;
+            }
+
             bool parentCanPop() const
             {
                 if(parent)
@@ -20,9 +20,11 @@ namespace xpipe
         {
             using Child = TaskNode<OUT>;
         public:
-            InterruptTaskNode(std::unique_ptr<Runnable<OUT>> runnable);
+            InterruptTaskNode(std::unique_ptr<Runnable<OUT>> runnable,
+                const StageOptions &options);
             ~InterruptTaskNode() override;
 
+            void configure(const PipelineOptions &options) override;
             void init() override;
             void destroy() override;
             bool run() override;
@@ -66,8 +68,9 @@ namespace xpipe
     {
         template<typename OUT>
         InterruptTaskNode<OUT>::InterruptTaskNode(
-            std::unique_ptr<Runnable<OUT>> runnable)
-            :inlet(*this),
+            std::unique_ptr<Runnable<OUT>> runnable,
+            const StageOptions &options)
+            :Child(options), inlet(*this),
             runnable(std::move(xpipe::inner::util::notNull(runnable))),
             parents_()
         {}
@@ -76,6 +79,13 @@ namespace xpipe
         InterruptTaskNode<OUT>::~InterruptTaskNode()
         {}
 
+        template<typename OUT>
+        void InterruptTaskNode<OUT>::configure(const PipelineOptions &options)
+        {
+            // the runnable may push from its own threads
+            Child::configureQueue(options, false);
+        }
+
         template<typename OUT>
         void InterruptTaskNode<OUT>::init()
         {
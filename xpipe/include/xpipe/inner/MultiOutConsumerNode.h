@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <memory>
 #include <cassert>
+#include <vector>
 
 #include "xpipe/inner/MultiOutTypedNode.h"
 #include "xpipe/inner/OutTypedNode.h"
@@ -36,6 +37,9 @@ namespace xpipe
 
             Nullable<typename std::tuple_element<I, std::tuple<Args...>>::type>
                 tryPop() override;
+            std::size_t tryPopBatch(std::vector<
+                typename std::tuple_element<I, std::tuple<Args...>>::type> &values,
+                std::size_t maxCount) override;
             bool canPop() const override;
             bool parentsAreDone() const override;
 
@@ -69,6 +73,15 @@ namespace xpipe
             return prev->template tryPop<I>();
         }
 
+        template<std::size_t I, class... Args>
+        std::size_t MultiOutConsumerNode<I, Args...>::tryPopBatch(std::vector<
+            typename std::tuple_element<I, std::tuple<Args...>>::type> &values,
+            std::size_t maxCount)
+        {
+            assert(prev);
+            return prev->template tryPopBatch<I>(values, maxCount);
+        }
+
         template<std::size_t I, class... Args>
         bool MultiOutConsumerNode<I, Args...>::canPop() const
         {
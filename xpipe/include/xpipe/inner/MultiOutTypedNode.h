@@ -1,17 +1,23 @@
 #ifndef XPIPE_INNER_MULTIOUTTYPEDNODE_H
 #define XPIPE_INNER_MULTIOUTTYPEDNODE_H
 
+#include <algorithm>
 #include <cstddef>
 #include <tuple>
-#include <cstddef>
+#include <array>
+#include <vector>
 
 #include "xpipe/Functional.h"
 #include "xpipe/IndexSequence.h"
 #include "xpipe/Inlet.h"
+#include "xpipe/PipelineOptions.h"
+#include "xpipe/StageOptions.h"
 #include "xpipe/inner/Node.h"
 #include "xpipe/inner/Nullable.h"
 #include "xpipe/inner/StageTraits.h"
 #include "xpipe/inner/AsyncQueue.h"
+#include "xpipe/inner/TaskCounters.h"
+#include "xpipe/inner/consumers.h"
 #include "xpipe/inner/graphptr.h"
 
 namespace xpipe
@@ -25,10 +31,19 @@ namespace xpipe
             using TaskTuple =
                 std::tuple<graphptr::LinkPointer<OutTypedNode<Outs>>...>;
         public:
+            MultiOutTypedNode(const StageOptions &options)
+                :queues(), capacity(options.getCapacity()), limits(),
+                consumers(), childrenTasks(), children_()
+            {}
+
             template<std::size_t I>
             Nullable<typename std::tuple_element<I, std::tuple<Outs...>>::type>
                 tryPop();
             template<std::size_t I>
+            std::size_t tryPopBatch(std::vector<
+                typename std::tuple_element<I, std::tuple<Outs...>>::type> &values,
+                std::size_t maxCount);
+            template<std::size_t I>
             bool canPop() const;
 
             const NodeCol &children() const override
@@ -52,6 +67,9 @@ namespace xpipe
         protected:
             virtual void notifyPull() = 0;
             virtual void notifyPush() = 0;
+            virtual TaskCounters *getCounters() = 0;
+
+            void configure(const PipelineOptions &options);
 
             template<class S>
             bool run(S &&stage, typename MultiOutStageTraits<MultiOutTypedNode, S>::InType &&value);
@@ -68,7 +86,14 @@ namespace xpipe
                 void push(
                     typename std::tuple_element<I, std::tuple<Outs...>>::type value) override
                 {
-                    node.template push<I>(value);
+                    node.template push<I>(std::move(value));
+                }
+
+                void pushBatch(
+                    typename std::tuple_element<I, std::tuple<Outs...>>::type *values,
+                    std::size_t count) override
+                {
+                    node.template pushBatch<I>(values, count);
                 }
 
                 MultiInlet(MultiOutTypedNode<Outs...> &node)
@@ -84,10 +109,49 @@ namespace xpipe
             void push(
                 typename std::tuple_element<I, std::tuple<Outs...>>::type value)
             {
-                std::get<I>(queues).push(std::move(value));
-                notifyPush();
+                const auto size = std::get<I>(queues).push(std::move(value));
+                countOut<I>(1);
+                pushed<I>(size, 1);
+            }
+
+            template<std::size_t I>
+            void pushBatch(
+                typename std::tuple_element<I, std::tuple<Outs...>>::type *values,
+                std::size_t count)
+            {
+                if(count == 0)
+                    return;
+                const auto size = std::get<I>(queues).pushBatch(values, count);
+                countOut<I>(count);
+                pushed<I>(size, count);
+            }
+
+            // same thresholds as in TaskNode
+            template<std::size_t I>
+            void pushed(std::size_t size, std::size_t count)
+            {
+                if(size < consumers[I] + count)
+                    notifyPush();
+            }
+
+            template<std::size_t I>
+            void pulled(std::size_t remaining, std::size_t count)
+            {
+                if(remaining == 0 ||
+                    (remaining < limits[I] && remaining + count >= limits[I]))
+                    notifyPull();
             }
 
+            template<std::size_t I>
+            void countOut(std::size_t count)
+            {
+                auto *const counters = getCounters();
+                if(counters)
+                    counters->countOut(I, count, std::get<I>(queues).size());
+            }
+
+            template<std::size_t... I>
+            void enableRings(IndexSequence<I...>);
             template<std::size_t... I>
             bool canPush(IndexSequence<I...>) const;
             template<std::size_t... I>
@@ -105,6 +169,9 @@ namespace xpipe
 
         private:
             std::tuple<AsyncQueue<Outs>...> queues;
+            Capacity capacity;
+            std::array<std::size_t, sizeof...(Outs)> limits;
+            std::array<std::size_t, sizeof...(Outs)> consumers;
             TaskTuple childrenTasks;
             NodeCol children_;
         };
@@ -114,12 +181,27 @@ namespace xpipe
         Nullable<typename std::tuple_element<I, std::tuple<Outs...>>::type>
             MultiOutTypedNode<Outs...>::tryPop()
         {
-            auto value = std::get<I>(queues).tryPop();
+            std::size_t remaining = 0;
+            auto value = std::get<I>(queues).tryPop(remaining);
             if(!value.isNull())
-                notifyPull();
+                pulled<I>(remaining, 1);
             return value;
         }
 
+        template<typename... Outs>
+        template<std::size_t I>
+        std::size_t MultiOutTypedNode<Outs...>::tryPopBatch(std::vector<
+            typename std::tuple_element<I, std::tuple<Outs...>>::type> &values,
+            std::size_t maxCount)
+        {
+            std::size_t remaining = 0;
+            const auto count = std::get<I>(queues).tryPopBatch(values,
+                maxCount, remaining);
+            if(count > 0)
+                pulled<I>(remaining, count);
+            return count;
+        }
+
         template<typename... Outs>
         template<std::size_t I>
         bool MultiOutTypedNode<Outs...>::canPop() const
@@ -142,6 +224,28 @@ namespace xpipe
             return canPush(MakeIndexSequence<sizeof...(Outs)>());
         }
 
+        template<typename... Outs>
+        void MultiOutTypedNode<Outs...>::configure(
+            const PipelineOptions &options)
+        {
+            const auto &cap = capacity.isSet()?capacity:options.capacity;
+            limits = std::array<std::size_t, sizeof...(Outs)>{
+                {cap.elementLimit(sizeof(Outs))...}};
+            enableRings(MakeIndexSequence<sizeof...(Outs)>());
+        }
+
+        template<typename... Outs>
+        template<std::size_t... I>
+        void MultiOutTypedNode<Outs...>::enableRings(IndexSequence<I...>)
+        {
+            assert(children_.size() == sizeof...(Outs));
+            consumers = std::array<std::size_t, sizeof...(Outs)>{
+                {std::max<std::size_t>(1, consumerTaskCount(*children_[I]))...}};
+            Pass{(consumers[I] == 1?
+                    (std::get<I>(queues).enableRing(limits[I]),nullptr):
+                    nullptr)...};
+        }
+
         template<typename... Outs>
         bool MultiOutTypedNode<Outs...>::queuesEmpty() const
         {
@@ -152,10 +256,8 @@ namespace xpipe
         template<std::size_t... I>
         bool MultiOutTypedNode<Outs...>::canPush(IndexSequence<I...>) const
         {
-            // TODO: move to proper place
-            constexpr std::size_t SIZE_LIMIT = 5;
             return reduce([](bool l, bool r){return l && r;}, true,
-                (std::get<I>(queues).size() <= SIZE_LIMIT)...);
+                (std::get<I>(queues).size() < limits[I])...);
         }
 
         template<typename... Outs>
@@ -1,6 +1,8 @@
 #ifndef XPIPE_INNER_MULTIPROCTASK_H
 #define XPIPE_INNER_MULTIPROCTASK_H
 
+#include <memory>
+#include <string>
 #include <tuple>
 
 #include "xpipe/inner/InTypedNode.h"
@@ -25,10 +27,17 @@ namespace xpipe
                 typename MultiOutStageTraits<MultiOutTypedNode, S>::TargetType;
 
         public:
-            MultiProcTask(S stage)
-                :stage(stage)
+            MultiProcTask(S stage, const StageOptions &options)
+                :Child(options), stage(stage), name(options.getName()),
+                node(options.getNode()),
+                threadGroup(options.getThreadGroup()),
+                dedicatedThread(options.hasDedicatedThread()), counters()
             {}
 
+            void configure(const PipelineOptions &options) override
+            {
+                Child::configure(options);
+            }
             void init() override
             {}
             void destroy() override
@@ -40,6 +49,47 @@ namespace xpipe
 
             virtual Listener *setListener(Listener *listener) override;
 
+            void setIndex(std::size_t index) override
+            {
+                this->index = index;
+            }
+
+            std::size_t getIndex() const override
+            {
+                return index;
+            }
+
+            const std::string &getName() const override
+            {
+                return name;
+            }
+
+            int getNode() const override
+            {
+                return node;
+            }
+
+            const std::string &getThreadGroup() const override
+            {
+                return threadGroup;
+            }
+
+            bool hasDedicatedThread() const override
+            {
+                return dedicatedThread;
+            }
+
+            void enableCounters() override
+            {
+                counters.reset(new TaskCounters(name,
+                        std::tuple_size<typename Child::TaskTuple>::value));
+            }
+
+            TaskCounters *getCounters() override
+            {
+                return counters.get();
+            }
+
             virtual Task *task() override
             {
                 return this;
@@ -68,6 +118,12 @@ namespace xpipe
             S stage;
             bool finished = false;
             Listener *listener = nullptr;
+            std::size_t index = 0;
+            std::string name;
+            int node;
+            std::string threadGroup;
+            bool dedicatedThread;
+            std::unique_ptr<TaskCounters> counters;
         };
 
         template<typename S>
@@ -89,6 +145,8 @@ namespace xpipe
             auto value = MultiProcTask::parentTryPop();
             if(!value.isNull())
             {
+                if(counters)
+                    counters->countIn(1);
                 if(!MultiOutStageTraits<MultiOutTypedNode, S>::TargetType::run(
                         stage, std::move(*value)))
                 {
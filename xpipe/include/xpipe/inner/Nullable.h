@@ -2,7 +2,9 @@
 #define XPIPE_INNER_NULLABLE_H
 
 #include <stdexcept>
-#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace xpipe
 {
@@ -17,6 +19,7 @@ namespace xpipe
             Nullable(Nullable &&that);
             explicit Nullable(const T &value);
             explicit Nullable(T &&value);
+            ~Nullable();
 
             Nullable &operator=(const Nullable &that);
             Nullable &operator=(Nullable &&that);
@@ -29,11 +32,24 @@ namespace xpipe
 
             bool isNull() const
             {
-                return !static_cast<bool>(value);
+                return !set;
             }
 
         private:
-            std::shared_ptr<T> value;
+            using Storage =
+                typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+        private:
+            T *get()
+            {
+                return reinterpret_cast<T*>(&storage);
+            }
+
+            void reset();
+
+        private:
+            Storage storage;
+            bool set;
         };
 
         template<typename T>
@@ -44,59 +60,93 @@ namespace xpipe
 
         template<typename T>
         Nullable<T>::Nullable(const Nullable &that)
-            :value(that.value
-                ?std::make_shared<T>(*that.value):std::shared_ptr<T>())
-        {}
+            :set(false)
+        {
+            if(that.set)
+            {
+                new(get()) T(*that);
+                set = true;
+            }
+        }
 
         template<typename T>
         Nullable<T>::Nullable(Nullable &&that)
-            :value(that.value
-                ?std::make_shared<T>(std::move(*that.value)):std::shared_ptr<T>())
-        {}
+            :set(false)
+        {
+            if(that.set)
+            {
+                new(get()) T(std::move(*that));
+                set = true;
+            }
+        }
 
         template<typename T>
         Nullable<T>::Nullable()
-            :value()
+            :set(false)
         {
         }
 
         template<typename T>
         Nullable<T>::Nullable(const T &value)
-            :value(std::make_shared<T>(value))
+            :set(false)
         {
+            new(get()) T(value);
+            set = true;
         }
 
         template<typename T>
         Nullable<T>::Nullable(T &&value)
-            :value(std::make_shared<T>(std::move(value)))
+            :set(false)
         {
+            new(get()) T(std::move(value));
+            set = true;
+        }
+
+        template<typename T>
+        Nullable<T>::~Nullable()
+        {
+            reset();
         }
 
         template<typename T>
         Nullable<T> &Nullable<T>::operator=(const Nullable &that)
         {
-            if(that.value)
-                this->value = std::make_shared<T>(*that.value);
+            if(this == &that)
+                return *this;
+            if(!that.set)
+                reset();
+            else if(set)
+                *get() = *that;
             else
-                this->value.reset();
+            {
+                new(get()) T(*that);
+                set = true;
+            }
             return *this;
         }
 
         template<typename T>
         Nullable<T> &Nullable<T>::operator=(Nullable &&that)
         {
-            if(that.value)
-                this->value = std::make_shared<T>(std::move(*that.value));
+            if(this == &that)
+                return *this;
+            if(!that.set)
+                reset();
+            else if(set)
+                *get() = std::move(*that);
             else
-                this->value.reset();
+            {
+                new(get()) T(std::move(*that));
+                set = true;
+            }
             return *this;
         }
 
         template<typename T>
         T &Nullable<T>::operator*()
         {
-            if(value)
-                return *value;
+            if(set)
+                return *get();
             throw std::invalid_argument("null object");
         }
 
@@ -117,6 +167,16 @@ namespace xpipe
         {
             return const_cast<Nullable<T>*>(this)->operator->();
         }
+
+        template<typename T>
+        void Nullable<T>::reset()
+        {
+            if(set)
+            {
+                get()->~T();
+                set = false;
+            }
+        }
     }
 }
 
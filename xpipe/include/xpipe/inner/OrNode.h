@@ -79,11 +79,9 @@ namespace xpipe
         {
             assert(!prevs.empty());
             const auto sz = prevs.size();
-            const auto rest = sz - prevIdx;
             for(std::size_t i = 0; i < sz; ++i)
             {
-                const auto idx = (i < rest)*prevIdx + i%rest;
-                assert(idx < sz);
+                const auto idx = (prevIdx + i)%sz;
                 auto value = prevs[idx]->tryPop();
                 if(!value.isNull())
                 {
@@ -0,0 +1,204 @@
+#ifndef XPIPE_INNER_ORDEREDNODE_H
+#define XPIPE_INNER_ORDEREDNODE_H
+
+#include <cstddef>
+#include <cassert>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+
+#include "xpipe/Inlet.h"
+#include "xpipe/inner/OutTypedNode.h"
+#include "xpipe/inner/StageTraits.h"
+#include "xpipe/inner/graphptr.h"
+
+namespace xpipe
+{
+    namespace inner
+    {
+        // tags the values with their sequence numbers
+        template<typename T>
+        class SequenceTagger
+        {
+        public:
+            bool operator()(T value, Inlet<std::pair<std::size_t, T>> &inlet)
+            {
+                inlet.push(std::make_pair(next++, std::move(value)));
+                return true;
+            }
+
+        private:
+            std::size_t next = 0;
+        };
+
+        // collects everything the stage pushes for a tagged value into one
+        // group with the same tag, empty if nothing was pushed
+        template<class S>
+        class GroupingStage
+        {
+        public:
+            using InType = typename StageTraits<S>::InType;
+            using OutType = typename StageTraits<S>::OutType;
+            using Group = std::pair<std::size_t, std::vector<OutType>>;
+
+        public:
+            explicit GroupingStage(S stage)
+                :stage(std::move(stage))
+            {}
+
+            bool operator()(std::pair<std::size_t, InType> value,
+                Inlet<Group> &inlet)
+            {
+                GroupInlet group;
+                const bool res = stage(std::move(value.second), group);
+                inlet.push(Group(value.first, std::move(group.values)));
+                return res;
+            }
+
+        private:
+            class GroupInlet final: public Inlet<OutType>
+            {
+            public:
+                void push(OutType value) override
+                {
+                    values.push_back(std::move(value));
+                }
+
+                std::vector<OutType> values;
+            };
+
+        private:
+            S stage;
+        };
+
+        // merges the groups of the parents back into the sequence order,
+        // each parent has to produce its groups in increasing order so at
+        // most one group per parent is held
+        template<typename OUT>
+        class OrderedNode: public OutTypedNode<OUT>
+        {
+        public:
+            using Group = std::pair<std::size_t, std::vector<OUT>>;
+            using NodePtrCol =
+                std::vector<graphptr::LinkPointer<OutTypedNode<Group>>>;
+
+        public:
+            OrderedNode();
+
+            OrderedNode(const OrderedNode&) = delete;
+            OrderedNode &operator=(const OrderedNode&) = delete;
+
+            void setParents(const NodePtrCol &prevs);
+
+            Task *task() override
+            {
+                return nullptr;
+            }
+
+            Nullable<OUT> tryPop() override;
+            bool canPop() const override;
+            bool parentsAreDone() const override;
+
+            const Node::NodeCol &parents() const override
+            {
+                return parents_;
+            }
+            void clearParents() override
+            {
+                parents_.clear();
+                prevs.clear();
+                held.clear();
+            }
+
+        private:
+            bool takeNext();
+
+        private:
+            NodePtrCol prevs;
+            Node::NodeCol parents_;
+            std::vector<Nullable<Group>> held;
+            std::vector<OUT> current;
+            std::size_t pos;
+            std::size_t next;
+        };
+
+        template<typename OUT>
+        OrderedNode<OUT>::OrderedNode()
+            :prevs(), parents_(), held(), current(), pos(0), next(0)
+        {}
+
+        template<typename OUT>
+        void OrderedNode<OUT>::setParents(const NodePtrCol &prevs)
+        {
+            parents_.clear();
+            this->prevs = prevs;
+            held.assign(prevs.size(), Nullable<Group>());
+            std::transform(std::begin(prevs), std::end(prevs),
+                std::back_inserter(parents_),
+                [](const typename NodePtrCol::value_type &prev){
+                    return prev.get();
+                });
+        }
+
+        template<typename OUT>
+        Nullable<OUT> OrderedNode<OUT>::tryPop()
+        {
+            assert(!prevs.empty());
+            while(pos == current.size())
+            {
+                if(!takeNext())
+                    return Nullable<OUT>();
+            }
+            return Nullable<OUT>(std::move(current[pos++]));
+        }
+
+        template<typename OUT>
+        bool OrderedNode<OUT>::canPop() const
+        {
+            assert(!prevs.empty());
+            if(pos < current.size())
+                return true;
+            for(std::size_t i = 0; i < prevs.size(); ++i)
+            {
+                if(held[i].isNull()?prevs[i]->canPop():held[i]->first == next)
+                    return true;
+            }
+            return false;
+        }
+
+        template<typename OUT>
+        bool OrderedNode<OUT>::parentsAreDone() const
+        {
+            if(pos < current.size())
+                return false;
+            for(std::size_t i = 0; i < prevs.size(); ++i)
+            {
+                if(!held[i].isNull() || !prevs[i]->parentsAreDone())
+                    return false;
+            }
+            return true;
+        }
+
+        template<typename OUT>
+        bool OrderedNode<OUT>::takeNext()
+        {
+            for(std::size_t i = 0; i < prevs.size(); ++i)
+            {
+                if(held[i].isNull())
+                    held[i] = prevs[i]->tryPop();
+                if(!held[i].isNull() && held[i]->first == next)
+                {
+                    current = std::move(held[i]->second);
+                    held[i] = Nullable<Group>();
+                    pos = 0;
+                    ++next;
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+}
+
+#endif
@@ -5,6 +5,8 @@
 #include <iterator>
 #include <memory>
 #include <cassert>
+#include <cstddef>
+#include <utility>
 #include <vector>
 
 #include "xpipe/inner/Nullable.h"
@@ -27,6 +29,9 @@ namespace xpipe
 
         public:
             virtual Nullable<OutType> tryPop() = 0;
+            // appends at most maxCount values, returns how many
+            virtual std::size_t tryPopBatch(std::vector<OutType> &values,
+                std::size_t maxCount);
             virtual bool canPop() const = 0;
 
             const NodeCol &children() const override
@@ -69,6 +74,21 @@ namespace xpipe
                 });
         }
 
+        template<typename Out>
+        std::size_t OutTypedNode<Out>::tryPopBatch(std::vector<OutType> &values,
+            std::size_t maxCount)
+        {
+            std::size_t count = 0;
+            for(; count < maxCount; ++count)
+            {
+                auto value = tryPop();
+                if(value.isNull())
+                    break;
+                values.push_back(std::move(*value));
+            }
+            return count;
+        }
+
         template<typename Out>
         bool OutTypedNode<Out>::childrenAreFinished() const
         {
@@ -18,6 +18,8 @@ namespace xpipe
 
         public:
             Nullable<T> tryPop() override;
+            std::size_t tryPopBatch(std::vector<T> &values,
+                std::size_t maxCount) override;
             bool canPop() const override;
             bool childrenAreFinished() const override;
 
@@ -33,6 +35,13 @@ namespace xpipe
             return ParNode::parentTryPop();
         }
 
+        template<typename In>
+        std::size_t ParNode<In>::tryPopBatch(std::vector<In> &values,
+            std::size_t maxCount)
+        {
+            return ParNode::parentTryPopBatch(values, maxCount);
+        }
+
         template<typename In>
         bool ParNode<In>::canPop() const
         {
@@ -0,0 +1,350 @@
+#ifndef XPIPE_INNER_PARTITIONTASKNODE_H
+#define XPIPE_INNER_PARTITIONTASKNODE_H
+
+#include <cstddef>
+#include <cassert>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include "xpipe/PipelineOptions.h"
+#include "xpipe/StageOptions.h"
+#include "xpipe/inner/AsyncQueue.h"
+#include "xpipe/inner/BaseTask.h"
+#include "xpipe/inner/InTypedNode.h"
+#include "xpipe/inner/OutTypedNode.h"
+#include "xpipe/inner/consumers.h"
+#include "xpipe/inner/graphptr.h"
+
+namespace xpipe
+{
+    namespace inner
+    {
+        // node with a runtime number of outputs of the same type
+        template<typename T>
+        class PartitionedNode: public virtual Node
+        {
+        public:
+            virtual Nullable<T> tryPop(std::size_t idx) = 0;
+            virtual std::size_t tryPopBatch(std::size_t idx,
+                std::vector<T> &values, std::size_t maxCount) = 0;
+            virtual bool canPop(std::size_t idx) const = 0;
+        };
+
+        template<typename T>
+        class PartitionConsumerNode: public OutTypedNode<T>
+        {
+        public:
+            explicit PartitionConsumerNode(std::size_t idx)
+                :idx(idx), prev(), parents_{}
+            {}
+
+            PartitionConsumerNode(const PartitionConsumerNode&) = delete;
+            PartitionConsumerNode &operator=(
+                const PartitionConsumerNode&) = delete;
+
+            void setParent(graphptr::LinkPointer<PartitionedNode<T>> prev)
+            {
+                this->prev = prev;
+                parents_ = Node::NodeCol{prev.get()};
+            }
+
+            Task *task() override
+            {
+                return nullptr;
+            }
+
+            Nullable<T> tryPop() override
+            {
+                assert(prev);
+                return prev->tryPop(idx);
+            }
+
+            std::size_t tryPopBatch(std::vector<T> &values,
+                std::size_t maxCount) override
+            {
+                assert(prev);
+                return prev->tryPopBatch(idx, values, maxCount);
+            }
+
+            bool canPop() const override
+            {
+                assert(prev);
+                return prev->canPop(idx);
+            }
+
+            bool parentsAreDone() const override
+            {
+                assert(prev);
+                return prev->parentsAreDone();
+            }
+
+            const Node::NodeCol &parents() const override
+            {
+                return parents_;
+            }
+            void clearParents() override
+            {
+                parents_.clear();
+                prev = graphptr::LinkPointer<PartitionedNode<T>>();
+            }
+
+        private:
+            std::size_t idx;
+            graphptr::LinkPointer<PartitionedNode<T>> prev;
+            Node::NodeCol parents_;
+        };
+
+        // routes each value to the output selected by the hash of its key,
+        // values with equal keys always go to the same output
+        template<typename T, class K>
+        class PartitionTaskNode: public BaseTask, public InTypedNode<T>,
+            public PartitionedNode<T>
+        {
+        private:
+            using Parent = InTypedNode<T>;
+            using KeyType = typename std::decay<
+                typename std::result_of<K&(const T&)>::type>::type;
+            using NodePtrCol = std::vector<graphptr::LinkPointer<Node>>;
+
+        public:
+            PartitionTaskNode(K key, std::size_t count,
+                const StageOptions &options);
+
+            PartitionTaskNode(const PartitionTaskNode&) = delete;
+            PartitionTaskNode &operator=(const PartitionTaskNode&) = delete;
+
+            void configure(const PipelineOptions &options) override;
+            bool run() override;
+            bool canRun() override;
+            bool parentsAreDone() const override;
+            bool childrenAreFinished() const override;
+
+            Task *task() override
+            {
+                return this;
+            }
+
+            Nullable<T> tryPop(std::size_t idx) override;
+            std::size_t tryPopBatch(std::size_t idx, std::vector<T> &values,
+                std::size_t maxCount) override;
+            bool canPop(std::size_t idx) const override;
+
+            const Node::NodeCol &children() const override
+            {
+                return children_;
+            }
+            void clearChildren() override
+            {
+                children_.clear();
+                nodes.clear();
+            }
+
+            void setChildren(const NodePtrCol &cs);
+
+        protected:
+            std::size_t outputCount() const override
+            {
+                return queues.size();
+            }
+
+        private:
+            bool shouldFinish() const;
+            bool consumersAreFinished() const;
+            bool canPush() const;
+            bool queuesEmpty() const;
+            void push(T &&value);
+
+        private:
+            K key;
+            std::hash<KeyType> hash;
+            std::vector<std::unique_ptr<AsyncQueue<T>>> queues;
+            Capacity capacity;
+            std::vector<std::size_t> limits;
+            std::vector<std::size_t> consumers;
+            NodePtrCol nodes;
+            Node::NodeCol children_;
+            bool finished = false;
+        };
+
+        template<typename T, class K>
+        PartitionTaskNode<T, K>::PartitionTaskNode(K key, std::size_t count,
+            const StageOptions &options)
+            :BaseTask(options), key(std::move(key)), hash(),
+            queues(), capacity(options.getCapacity()), limits(count, 0),
+            consumers(count, 1), nodes(), children_()
+        {
+            for(std::size_t i = 0; i < count; ++i)
+                queues.emplace_back(new AsyncQueue<T>());
+        }
+
+        template<typename T, class K>
+        void PartitionTaskNode<T, K>::setChildren(const NodePtrCol &cs)
+        {
+            assert(cs.size() == queues.size());
+            nodes = cs;
+            children_.clear();
+            std::transform(std::begin(nodes), std::end(nodes),
+                std::back_inserter(children_),
+                [](const typename NodePtrCol::value_type &n){
+                    return n.get();
+                });
+        }
+
+        template<typename T, class K>
+        void PartitionTaskNode<T, K>::configure(
+            const PipelineOptions &options)
+        {
+            assert(children_.size() == queues.size());
+            const auto limit = (capacity.isSet()?capacity:options.capacity)
+                .elementLimit(sizeof(T));
+            for(std::size_t i = 0; i < queues.size(); ++i)
+            {
+                limits[i] = limit;
+                consumers[i] = std::max<std::size_t>(1,
+                    consumerTaskCount(*children_[i]));
+                if(consumers[i] == 1)
+                    queues[i]->enableRing(limit);
+            }
+        }
+
+        template<typename T, class K>
+        bool PartitionTaskNode<T, K>::run()
+        {
+            if(finished)
+            {
+                notifyFinished();
+                return false;
+            }
+            if(shouldFinish())
+            {
+                finished = true;
+                notifyFinished();
+                return false;
+            }
+            if(!canPush())
+                return false;
+            auto value = PartitionTaskNode::parentTryPop();
+            if(!value.isNull())
+            {
+                countIn(1);
+                push(std::move(*value));
+                return true;
+            }
+            return false;
+        }
+
+        template<typename T, class K>
+        bool PartitionTaskNode<T, K>::canRun()
+        {
+            return (canPush() && PartitionTaskNode::parentCanPop()) ||
+                shouldFinish();
+        }
+
+        template<typename T, class K>
+        bool PartitionTaskNode<T, K>::parentsAreDone() const
+        {
+            return finished && queuesEmpty();
+        }
+
+        template<typename T, class K>
+        bool PartitionTaskNode<T, K>::childrenAreFinished() const
+        {
+            return finished;
+        }
+
+        template<typename T, class K>
+        Nullable<T> PartitionTaskNode<T, K>::tryPop(std::size_t idx)
+        {
+            std::size_t remaining = 0;
+            auto value = queues[idx]->tryPop(remaining);
+            // same thresholds as in TaskNode
+            if(!value.isNull() && (remaining == 0 ||
+                    (remaining < limits[idx] && remaining + 1 >= limits[idx])))
+                notifyPull();
+            return value;
+        }
+
+        template<typename T, class K>
+        std::size_t PartitionTaskNode<T, K>::tryPopBatch(std::size_t idx,
+            std::vector<T> &values, std::size_t maxCount)
+        {
+            std::size_t remaining = 0;
+            const auto count = queues[idx]->tryPopBatch(values, maxCount,
+                remaining);
+            if(count > 0 && (remaining == 0 ||
+                    (remaining < limits[idx] &&
+                     remaining + count >= limits[idx])))
+                notifyPull();
+            return count;
+        }
+
+        template<typename T, class K>
+        bool PartitionTaskNode<T, K>::canPop(std::size_t idx) const
+        {
+            return !queues[idx]->empty();
+        }
+
+        template<typename T, class K>
+        bool PartitionTaskNode<T, K>::shouldFinish() const
+        {
+            return Parent::parentsAreDone() || consumersAreFinished();
+        }
+
+        // as with multimap, the stage is done when any output is
+        template<typename T, class K>
+        bool PartitionTaskNode<T, K>::consumersAreFinished() const
+        {
+            if(children_.empty())
+                return true;
+            for(auto *c : children_)
+            {
+                assert(c);
+                if(c->childrenAreFinished())
+                    return true;
+            }
+            return false;
+        }
+
+        // a full output holds back the values of all the others
+        template<typename T, class K>
+        bool PartitionTaskNode<T, K>::canPush() const
+        {
+            for(std::size_t i = 0; i < queues.size(); ++i)
+            {
+                if(queues[i]->size() >= limits[i])
+                    return false;
+            }
+            return true;
+        }
+
+        template<typename T, class K>
+        bool PartitionTaskNode<T, K>::queuesEmpty() const
+        {
+            for(const auto &q : queues)
+            {
+                if(!q->empty())
+                    return false;
+            }
+            return true;
+        }
+
+        template<typename T, class K>
+        void PartitionTaskNode<T, K>::push(T &&value)
+        {
+            const auto idx = hash(key(value))%queues.size();
+            const auto size = queues[idx]->push(std::move(value));
+            auto *const counters = getCounters();
+            if(counters)
+                counters->countOut(idx, 1, size);
+            if(size < consumers[idx] + 1)
+                notifyPush();
+        }
+    }
+}
+
+#endif
@@ -24,7 +24,7 @@ namespace xpipe
             using Child = BaseTaskNode<typename StageTraits<S>::OutType>;
 
         public:
-            ProcTaskNode(S stage);
+            ProcTaskNode(S stage, const StageOptions &options);
 
             ProcTaskNode(const ProcTaskNode&) = delete;
             ProcTaskNode &operator=(const ProcTaskNode&) = delete;
@@ -44,8 +44,8 @@ namespace xpipe
         };
 
         template<class S>
-        ProcTaskNode<S>::ProcTaskNode(S stage)
-            :stage(std::move(stage))
+        ProcTaskNode<S>::ProcTaskNode(S stage, const StageOptions &options)
+            :Child(options), stage(std::move(stage))
         {}
 
         template<class S>
@@ -67,6 +67,7 @@ namespace xpipe
             auto value = ProcTaskNode::parentTryPop();
             if(!value.isNull())
             {
+                ProcTaskNode::countIn(1);
                 if(!this->stage(std::move(*value), ProcTaskNode::getInlet()))
                 {
                     finished = true;
@@ -0,0 +1,131 @@
+#ifndef XPIPE_INNER_RUNNABLESINKTASKNODE_H
+#define XPIPE_INNER_RUNNABLESINKTASKNODE_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <cassert>
+
+#include "xpipe/RunnableSink.h"
+#include "xpipe/StageOptions.h"
+#include "xpipe/inner/Task.h"
+#include "xpipe/inner/BaseTask.h"
+#include "xpipe/inner/InTypedNode.h"
+#include "xpipe/inner/util.h"
+
+namespace xpipe
+{
+    namespace inner
+    {
+        // passes the runnable up to maxSize of the values available at once
+        template<typename IN>
+        class RunnableSinkTaskNode: public BaseTask, public InTypedNode<IN>,
+            private RunnableOutlet
+        {
+            using Parent = InTypedNode<IN>;
+        public:
+            RunnableSinkTaskNode(std::size_t maxSize,
+                std::unique_ptr<RunnableSink<IN>> runnable,
+                const StageOptions &options)
+                :BaseTask(options),
+                runnable(std::move(util::notNull(runnable))),
+                maxSize(maxSize), batch(), children_{}
+            {
+                assert(maxSize > 0);
+            }
+
+            RunnableSinkTaskNode(const RunnableSinkTaskNode&) = delete;
+            RunnableSinkTaskNode &operator=(
+                const RunnableSinkTaskNode&) = delete;
+
+            const Node::NodeCol &children() const override
+            {
+                return children_;
+            }
+            void clearChildren() override
+            {
+                children_.clear();
+            }
+
+            Task *task() override
+            {
+                return this;
+            }
+
+            void init() override
+            {
+                batch.clear();
+                runnable->init(*this);
+            }
+
+            void destroy() override
+            {
+                runnable->destroy();
+            }
+
+            bool run() override;
+            bool canRun() override;
+            bool parentsAreDone() const override
+            {
+                return finished;
+            }
+            bool childrenAreFinished() const override
+            {
+                return finished;
+            }
+
+        private:
+            void notifyCanRun() override
+            {
+                RunnableSinkTaskNode::notifySelf();
+            }
+
+        private:
+            std::unique_ptr<RunnableSink<IN>> runnable;
+            std::size_t maxSize;
+            // what the runnable has not taken yet
+            std::vector<IN> batch;
+            Node::NodeCol children_;
+            bool finished = false;
+        };
+
+        template<typename IN>
+        bool RunnableSinkTaskNode<IN>::run()
+        {
+            if(finished)
+            {
+                RunnableSinkTaskNode::notifyFinished();
+                return false;
+            }
+            if(!runnable->canRun())
+                return false;
+            if(batch.empty())
+            {
+                // nothing is pushed once the parents are done
+                const bool ended = Parent::parentsAreDone();
+                if(RunnableSinkTaskNode::parentTryPopBatch(batch,
+                        maxSize) > 0)
+                    RunnableSinkTaskNode::countIn(batch.size());
+                else if(!ended)
+                    return false;
+            }
+            if(!runnable->run(batch))
+            {
+                finished = true;
+                RunnableSinkTaskNode::notifyFinished();
+                return false;
+            }
+            return true;
+        }
+
+        template<typename IN>
+        bool RunnableSinkTaskNode<IN>::canRun()
+        {
+            return finished || (runnable->canRun() && (!batch.empty() ||
+                    RunnableSinkTaskNode::parentCanPop() ||
+                    Parent::parentsAreDone()));
+        }
+    }
+}
+
+#endif
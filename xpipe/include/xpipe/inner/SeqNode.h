@@ -6,6 +6,7 @@
 #include <functional>
 #include <stdexcept>
 #include <cassert>
+#include <vector>
 
 #include "xpipe/inner/OutTypedNode.h"
 #include "xpipe/inner/graphptr.h"
@@ -35,6 +36,8 @@ namespace xpipe
             }
 
             Nullable<OUT> tryPop() override;
+            std::size_t tryPopBatch(std::vector<OUT> &values,
+                std::size_t maxCount) override;
             bool canPop() const override;
             bool parentsAreDone() const override;
 
@@ -86,6 +89,22 @@ namespace xpipe
             return Nullable<OUT>();
         }
 
+        template<typename OUT>
+        std::size_t SeqNode<OUT>::tryPopBatch(std::vector<OUT> &values,
+            std::size_t maxCount)
+        {
+            assert(!prevs.empty());
+            while(prevIdx < prevs.size())
+            {
+                if(!prevs[prevIdx]->parentsAreDone())
+                {
+                    return prevs[prevIdx]->tryPopBatch(values, maxCount);
+                }
+                ++prevIdx;
+            }
+            return 0;
+        }
+
         template<typename OUT>
         bool SeqNode<OUT>::canPop() const
         {
@@ -1,7 +1,9 @@
 #ifndef XPIPE_INNER_SINKTASKNODE_H
 #define XPIPE_INNER_SINKTASKNODE_H
 
+#include "xpipe/StageOptions.h"
 #include "xpipe/inner/Task.h"
+#include "xpipe/inner/BaseTask.h"
 #include "xpipe/inner/InTypedNode.h"
 
 namespace xpipe
@@ -14,8 +16,9 @@ namespace xpipe
         {
             using Parent = InTypedNode<typename SinkStageTraits<S>::InType>;
         public:
-            SinkTaskNode(S stage)
-                :stage(std::move(stage)), children_{}
+            SinkTaskNode(S stage, const StageOptions &options)
+                :BaseTask(options), stage(std::move(stage)),
+                children_{}
             {}
 
             SinkTaskNode(const SinkTaskNode&) = delete;
@@ -69,14 +72,16 @@ namespace xpipe
             auto value = SinkTaskNode::parentTryPop();
             if(!value.isNull())
             {
+                SinkTaskNode::countIn(1);
                 if(!this->stage(std::move(*value)))
                 {
                     finished = true;
                     SinkTaskNode::notifyFinished();
                     return false;
                 }
+                return true;
             }
-            return true;
+            return false;
         }
 
         template<class S>
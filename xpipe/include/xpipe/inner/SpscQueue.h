@@ -0,0 +1,134 @@
+#ifndef XPIPE_INNER_SPSCQUEUE_H
+#define XPIPE_INNER_SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "xpipe/inner/Nullable.h"
+
+namespace xpipe
+{
+    namespace inner
+    {
+        // bounded lock-free ring, one thread may push and one may pop
+        // at a time, size queries are allowed from anywhere
+        template<typename T>
+        class SpscQueue
+        {
+        public:
+            explicit SpscQueue(std::size_t capacity);
+            ~SpscQueue();
+
+            // moves from the value only on success
+            bool tryPush(T &value);
+            Nullable<T> tryPop();
+            bool empty() const;
+            std::size_t size() const;
+
+            SpscQueue(const SpscQueue&) = delete;
+            SpscQueue &operator=(const SpscQueue&) = delete;
+
+        private:
+            using Slot =
+                typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+            static constexpr std::size_t CACHE_LINE = 64;
+
+        private:
+            static std::size_t roundCapacity(std::size_t capacity);
+
+            T *slot(std::size_t idx)
+            {
+                return reinterpret_cast<T*>(&slots[idx&mask]);
+            }
+
+        private:
+            const std::size_t mask;
+            std::unique_ptr<Slot[]> slots;
+            char headPad[CACHE_LINE];
+            std::atomic<std::size_t> head;
+            std::size_t cachedTail;
+            char tailPad[CACHE_LINE];
+            std::atomic<std::size_t> tail;
+            std::size_t cachedHead;
+            char endPad[CACHE_LINE];
+        };
+
+        template<typename T>
+        SpscQueue<T>::SpscQueue(std::size_t capacity)
+            :mask(roundCapacity(capacity) - 1),
+            slots(new Slot[mask + 1]),
+            head(0), cachedTail(0), tail(0), cachedHead(0)
+        {}
+
+        template<typename T>
+        SpscQueue<T>::~SpscQueue()
+        {
+            const auto end = tail.load();
+            for(auto i = head.load(); i != end; ++i)
+                slot(i)->~T();
+        }
+
+        template<typename T>
+        bool SpscQueue<T>::tryPush(T &value)
+        {
+            const auto t = tail.load(std::memory_order_relaxed);
+            if(t - cachedHead > mask)
+            {
+                cachedHead = head.load(std::memory_order_acquire);
+                if(t - cachedHead > mask)
+                    return false;
+            }
+            new(slot(t)) T(std::move(value));
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        template<typename T>
+        Nullable<T> SpscQueue<T>::tryPop()
+        {
+            const auto h = head.load(std::memory_order_relaxed);
+            if(h == cachedTail)
+            {
+                cachedTail = tail.load(std::memory_order_acquire);
+                if(h == cachedTail)
+                    return Nullable<T>();
+            }
+            auto *const value = slot(h);
+            Nullable<T> res(std::move(*value));
+            value->~T();
+            head.store(h + 1, std::memory_order_release);
+            return res;
+        }
+
+        template<typename T>
+        bool SpscQueue<T>::empty() const
+        {
+            return size() == 0;
+        }
+
+        template<typename T>
+        std::size_t SpscQueue<T>::size() const
+        {
+            // head first, tail never falls behind it
+            const auto h = head.load(std::memory_order_acquire);
+            const auto t = tail.load(std::memory_order_acquire);
+            return t - h;
+        }
+
+        template<typename T>
+        std::size_t SpscQueue<T>::roundCapacity(std::size_t capacity)
+        {
+            std::size_t res = 2;
+            while(res < capacity)
+                res *= 2;
+            return res;
+        }
+    }
+}
+
+#endif
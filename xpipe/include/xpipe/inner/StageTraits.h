@@ -3,6 +3,7 @@
 
 #include <tuple>
 #include <type_traits>
+#include <utility>
 
 #include "xpipe/Inlet.h"
 
@@ -126,6 +127,44 @@ namespace xpipe
             SinkStageTraits() = default;
         };
 
+        // stages taking a vector of values
+        template<class F>
+        struct BatchStageTraits
+        {
+            using BatchType = typename StageTraits<F>::InType;
+            using InType = typename BatchType::value_type;
+            using OutType = typename StageTraits<F>::OutType;
+
+        private:
+            BatchStageTraits() = default;
+        };
+
+        // whether the stage has void finish(Inlet<OUT>&)
+        template<class F, class OUT>
+        struct HasFinish
+        {
+        private:
+            template<class C>
+            static auto check(C *stage) -> decltype(
+                stage->finish(std::declval<Inlet<OUT>&>()), std::true_type());
+            template<class C>
+            static std::false_type check(...);
+
+        public:
+            static const bool value = decltype(check<F>(nullptr))::value;
+        };
+
+        template<class F>
+        struct BatchSinkStageTraits
+        {
+            using BatchType = typename SinkStageTraits<
+                typename std::decay<F>::type>::InType;
+            using InType = typename BatchType::value_type;
+
+        private:
+            BatchSinkStageTraits() = default;
+        };
+
         template<template<typename...> class T, class F>
         struct MultiOutStageTraits
         {
@@ -1,8 +1,13 @@
 #ifndef XPIPE_INNER_TASK_H
 #define XPIPE_INNER_TASK_H
 
+#include <cstddef>
+#include <string>
 #include <vector>
 
+#include "xpipe/PipelineOptions.h"
+#include "xpipe/inner/TaskCounters.h"
+
 namespace xpipe
 {
     namespace inner
@@ -24,12 +29,28 @@ namespace xpipe
         public:
             virtual ~Task() = default;
 
+            virtual void configure(const PipelineOptions &options) = 0;
             virtual void init() = 0;
             virtual void destroy() = 0;
             virtual bool run() = 0;
             virtual bool canRun() = 0;
 
             virtual Listener *setListener(Listener *listener) = 0;
+            // position of the task in the graph given by the scheduler
+            virtual void setIndex(std::size_t index) = 0;
+            virtual std::size_t getIndex() const = 0;
+
+            // from the stage options, may be empty
+            virtual const std::string &getName() const = 0;
+            // from the stage options, -1 for any
+            virtual int getNode() const = 0;
+            // from the stage options, empty for the shared workers
+            virtual const std::string &getThreadGroup() const = 0;
+            virtual bool hasDedicatedThread() const = 0;
+
+            virtual void enableCounters() = 0;
+            // null unless the counters are enabled
+            virtual TaskCounters *getCounters() = 0;
         };
     }
 }
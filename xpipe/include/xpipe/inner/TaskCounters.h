@@ -0,0 +1,143 @@
+#ifndef XPIPE_INNER_TASKCOUNTERS_H
+#define XPIPE_INNER_TASKCOUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "xpipe/Statistics.h"
+
+namespace xpipe
+{
+    namespace inner
+    {
+        // updated by the workers while the pipeline runs, read at any time
+        class TaskCounters
+        {
+        public:
+            using Clock = std::chrono::steady_clock;
+
+        public:
+            // with a histogram for each output queue
+            TaskCounters(const std::string &name, std::size_t outputCount)
+                :name(name), valuesIn(0), valuesOut(0), runs(0), busyNs(0),
+                readyWaitNs(0), readySince(0), outputCount(outputCount),
+                depths(new DepthHistogram[outputCount])
+            {
+                for(std::size_t i = 0; i < outputCount; ++i)
+                {
+                    for(auto &d : depths[i])
+                        d = 0;
+                }
+            }
+
+            TaskCounters(const TaskCounters&) = delete;
+            TaskCounters &operator=(const TaskCounters&) = delete;
+
+            void countIn(std::size_t count)
+            {
+                valuesIn.fetch_add(count, std::memory_order_relaxed);
+            }
+
+            void countOut(std::size_t output, std::size_t count,
+                std::size_t depth)
+            {
+                assert(output < outputCount);
+                valuesOut.fetch_add(count, std::memory_order_relaxed);
+                depths[output][depthBucket(depth)].fetch_add(1,
+                    std::memory_order_relaxed);
+            }
+
+            void countRuns(std::size_t count, Clock::duration busy)
+            {
+                runs.fetch_add(count, std::memory_order_relaxed);
+                busyNs.fetch_add(toNs(busy), std::memory_order_relaxed);
+            }
+
+            void markReady(Clock::time_point now)
+            {
+                readySince.store(toNs(now.time_since_epoch()),
+                    std::memory_order_relaxed);
+            }
+
+            void markTaken(Clock::time_point now)
+            {
+                const auto since = readySince.load(std::memory_order_relaxed);
+                const auto cur = toNs(now.time_since_epoch());
+                if(cur > since)
+                    readyWaitNs.fetch_add(cur - since,
+                        std::memory_order_relaxed);
+            }
+
+            TaskStatistics snapshot() const
+            {
+                TaskStatistics res;
+                res.name = name;
+                res.valuesIn = valuesIn.load(std::memory_order_relaxed);
+                res.valuesOut = valuesOut.load(std::memory_order_relaxed);
+                res.runs = runs.load(std::memory_order_relaxed);
+                res.busyTime = std::chrono::nanoseconds(
+                    busyNs.load(std::memory_order_relaxed));
+                res.readyWaitTime = std::chrono::nanoseconds(
+                    readyWaitNs.load(std::memory_order_relaxed));
+                for(std::size_t o = 0; o < outputCount; ++o)
+                {
+                    const auto &histogram = depths[o];
+                    std::size_t used = 0;
+                    for(std::size_t i = 0; i < histogram.size(); ++i)
+                    {
+                        if(histogram[i].load(std::memory_order_relaxed) > 0)
+                            used = i + 1;
+                    }
+                    res.queueDepth.emplace_back();
+                    for(std::size_t i = 0; i < used; ++i)
+                        res.queueDepth.back().push_back(
+                            histogram[i].load(std::memory_order_relaxed));
+                }
+                return res;
+            }
+
+        private:
+            static constexpr std::size_t DEPTH_BUCKETS = 33;
+
+            using DepthHistogram =
+                std::array<std::atomic<std::uint64_t>, DEPTH_BUCKETS>;
+
+        private:
+            static std::size_t depthBucket(std::size_t depth)
+            {
+                std::size_t bucket = 0;
+                while(depth > 0 && bucket + 1 < DEPTH_BUCKETS)
+                {
+                    depth >>= 1;
+                    ++bucket;
+                }
+                return bucket;
+            }
+
+            static std::uint64_t toNs(Clock::duration duration)
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    duration).count();
+            }
+
+        private:
+            const std::string name;
+            std::atomic<std::uint64_t> valuesIn;
+            std::atomic<std::uint64_t> valuesOut;
+            std::atomic<std::uint64_t> runs;
+            std::atomic<std::uint64_t> busyNs;
+            std::atomic<std::uint64_t> readyWaitNs;
+            std::atomic<std::uint64_t> readySince;
+            const std::size_t outputCount;
+            std::unique_ptr<DepthHistogram[]> depths;
+        };
+    }
+}
+
+#endif
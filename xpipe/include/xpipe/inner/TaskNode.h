@@ -1,11 +1,17 @@
 #ifndef XPIPE_INNER_TASKNODE_H
 #define XPIPE_INNER_TASKNODE_H
 
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
 #include "xpipe/Inlet.h"
+#include "xpipe/StageOptions.h"
 #include "xpipe/inner/Task.h"
 #include "xpipe/inner/OutTypedNode.h"
 #include "xpipe/inner/AsyncQueue.h"
 #include "xpipe/inner/BaseTask.h"
+#include "xpipe/inner/consumers.h"
 
 namespace xpipe
 {
@@ -15,11 +21,16 @@ namespace xpipe
         class TaskNode: public BaseTask, public OutTypedNode<OUT>
         {
         public:
-            TaskNode()
-                :queue()
+            TaskNode(const StageOptions &options)
+                :BaseTask(options), queue(),
+                capacity(options.getCapacity()), limit(0), consumers(1)
             {}
 
+            void configure(const PipelineOptions &options) override;
+
             Nullable<OUT> tryPop() override;
+            std::size_t tryPopBatch(std::vector<OUT> &values,
+                std::size_t maxCount) override;
             bool canPop() const override;
 
             Task *task() override
@@ -28,10 +39,14 @@ namespace xpipe
             }
 
             void push(OUT &&value);
+            void pushBatch(OUT *values, std::size_t count);
 
         protected:
             bool canPush() const;
 
+            void configureQueue(const PipelineOptions &options,
+                bool singleProducer);
+
             virtual Inlet<OUT> &getInlet() = 0;
 
             bool queueEmpty() const
@@ -39,19 +54,79 @@ namespace xpipe
                 return queue.empty();
             }
 
+            std::size_t outputCount() const override
+            {
+                return 1;
+            }
+
+        private:
+            // only the changes that may make the consumers or the producer
+            // runnable are reported
+            void pushed(std::size_t size, std::size_t count)
+            {
+                if(size < consumers + count)
+                    notifyPush();
+            }
+
+            void pulled(std::size_t remaining, std::size_t count)
+            {
+                if(remaining == 0 ||
+                    (remaining < limit && remaining + count >= limit))
+                    notifyPull();
+            }
+
+            void countOut(std::size_t count)
+            {
+                auto *const counters = getCounters();
+                if(counters)
+                    counters->countOut(0, count, queue.size());
+            }
+
         private:
             AsyncQueue<OUT> queue;
+            Capacity capacity;
+            std::size_t limit;
+            std::size_t consumers;
         };
 
+        template<typename OUT>
+        void TaskNode<OUT>::configure(const PipelineOptions &options)
+        {
+            configureQueue(options, true);
+        }
+
+        template<typename OUT>
+        void TaskNode<OUT>::configureQueue(const PipelineOptions &options,
+            bool singleProducer)
+        {
+            limit = (capacity.isSet()?capacity:options.capacity).elementLimit(
+                sizeof(OUT));
+            consumers = std::max<std::size_t>(1, consumerTaskCount(*this));
+            if(singleProducer && consumers == 1)
+                queue.enableRing(limit);
+        }
+
         template<typename OUT>
         Nullable<OUT> TaskNode<OUT>::tryPop()
         {
-            auto value = queue.tryPop();
+            std::size_t remaining = 0;
+            auto value = queue.tryPop(remaining);
             if(!value.isNull())
-                notifyPull();
+                pulled(remaining, 1);
             return value;
         }
 
+        template<typename OUT>
+        std::size_t TaskNode<OUT>::tryPopBatch(std::vector<OUT> &values,
+            std::size_t maxCount)
+        {
+            std::size_t remaining = 0;
+            const auto count = queue.tryPopBatch(values, maxCount, remaining);
+            if(count > 0)
+                pulled(remaining, count);
+            return count;
+        }
+
         template<typename OUT>
         bool TaskNode<OUT>::canPop() const
         {
@@ -61,14 +136,25 @@ namespace xpipe
         template<typename OUT>
         void TaskNode<OUT>::push(OUT &&value)
         {
-            queue.push(std::move(value));
-            notifyPush();
+            const auto size = queue.push(std::move(value));
+            countOut(1);
+            pushed(size, 1);
+        }
+
+        template<typename OUT>
+        void TaskNode<OUT>::pushBatch(OUT *values, std::size_t count)
+        {
+            if(count == 0)
+                return;
+            const auto size = queue.pushBatch(values, count);
+            countOut(count);
+            pushed(size, count);
         }
+
         template<typename OUT>
         bool TaskNode<OUT>::canPush() const
         {
-            constexpr std::size_t SIZE_LIMIT = 5;
-            return queue.size() <= SIZE_LIMIT;
+            return queue.size() < limit;
         }
 
     }
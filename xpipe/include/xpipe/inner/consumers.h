@@ -0,0 +1,44 @@
+#ifndef XPIPE_INNER_CONSUMERS_H
+#define XPIPE_INNER_CONSUMERS_H
+
+#include <cassert>
+#include <cstddef>
+#include <queue>
+#include <unordered_set>
+
+#include "xpipe/inner/Node.h"
+
+namespace xpipe
+{
+    namespace inner
+    {
+        // number of tasks popping from the output of the node
+        inline std::size_t consumerTaskCount(Node &node)
+        {
+            std::unordered_set<Task*> tasks;
+            std::unordered_set<Node*> seen{&node};
+            std::queue<Node*> front;
+            front.push(&node);
+            while(!front.empty())
+            {
+                auto *const cur = front.front();
+                front.pop();
+                assert(cur);
+                for(auto *c : cur->children())
+                {
+                    assert(c);
+                    if(!seen.insert(c).second)
+                        continue;
+                    auto *const task = c->task();
+                    if(task != nullptr)
+                        tasks.insert(task);
+                    else
+                        front.push(c);
+                }
+            }
+            return tasks.size();
+        }
+    }
+}
+
+#endif
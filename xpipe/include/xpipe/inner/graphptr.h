@@ -341,6 +341,7 @@ namespace xpipe
                     storage->decrement();
                 this->storage = that.storage;
                 this->data = that.data;
+                return *this;
             }
 
             template<typename T>
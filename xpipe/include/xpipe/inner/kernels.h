@@ -0,0 +1,93 @@
+#ifndef XPIPE_INNER_KERNELS_H
+#define XPIPE_INNER_KERNELS_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace xpipe
+{
+    namespace inner
+    {
+        // loops over contiguous values, float and double (and the
+        // conversions between them and from int32) use the widest vector
+        // instructions of the processor, other types are handled one by one
+        namespace kernels
+        {
+            enum class Isa
+            {
+                Scalar,
+                Sse2,
+                Avx2
+            };
+
+            // the best one the processor supports
+            Isa supportedIsa();
+            Isa activeIsa();
+            // limited to the supported one, meant for testing
+            void setIsa(Isa isa);
+
+            // out[i] = a*in[i] + b, in and out may be the same
+            template<typename T>
+            void affine(const T *in, T *out, std::size_t count, T a, T b)
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                    out[i] = a*in[i] + b;
+            }
+            void affine(const float *in, float *out, std::size_t count,
+                float a, float b);
+            void affine(const double *in, double *out, std::size_t count,
+                double a, double b);
+
+            // vectorized sums add in a different order than the scalar one
+            template<typename T>
+            T sum(const T *values, std::size_t count)
+            {
+                T res = T();
+                for(std::size_t i = 0; i < count; ++i)
+                    res += values[i];
+                return res;
+            }
+            float sum(const float *values, std::size_t count);
+            double sum(const double *values, std::size_t count);
+
+            // count is not 0, the result for NaN is unspecified
+            template<typename T>
+            T min(const T *values, std::size_t count)
+            {
+                assert(count > 0);
+                T res = values[0];
+                for(std::size_t i = 1; i < count; ++i)
+                    res = values[i] < res?values[i]:res;
+                return res;
+            }
+            float min(const float *values, std::size_t count);
+            double min(const double *values, std::size_t count);
+
+            template<typename T>
+            T max(const T *values, std::size_t count)
+            {
+                assert(count > 0);
+                T res = values[0];
+                for(std::size_t i = 1; i < count; ++i)
+                    res = values[i] > res?values[i]:res;
+                return res;
+            }
+            float max(const float *values, std::size_t count);
+            double max(const double *values, std::size_t count);
+
+            template<typename From, typename To>
+            void convert(const From *in, To *out, std::size_t count)
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                    out[i] = static_cast<To>(in[i]);
+            }
+            void convert(const float *in, double *out, std::size_t count);
+            void convert(const double *in, float *out, std::size_t count);
+            void convert(const std::int32_t *in, double *out,
+                std::size_t count);
+        }
+    }
+}
+
+#endif
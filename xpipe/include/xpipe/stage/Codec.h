@@ -0,0 +1,82 @@
+#ifndef XPIPE_STAGE_CODEC_H
+#define XPIPE_STAGE_CODEC_H
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace xpipe
+{
+    namespace stage
+    {
+        // the codecs turn values into bytes for the transports between
+        // processes and back, size is what encode writes for the value
+
+        // copies the bytes of the value, both sides have to lay it out the
+        // same way
+        template<typename T>
+        struct TrivialCodec
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                "the value is not trivially copyable");
+
+            std::size_t size(const T&) const
+            {
+                return sizeof(T);
+            }
+
+            std::size_t encode(const T &value, char *data,
+                std::size_t size) const
+            {
+                if(size < sizeof(T))
+                    throw std::length_error("value does not fit the slot");
+                std::memcpy(data, &value, sizeof(T));
+                return sizeof(T);
+            }
+
+            T decode(const char *data, std::size_t size) const
+            {
+                if(size != sizeof(T))
+                    throw std::length_error("bytes are not of the value");
+                T res;
+                std::memcpy(&res, data, sizeof(T));
+                return res;
+            }
+        };
+
+        // the codecs writing sizeof(T) bytes for every value
+        template<class Codec>
+        struct IsTrivialCodec: std::false_type
+        {};
+
+        template<typename T>
+        struct IsTrivialCodec<TrivialCodec<T>>: std::true_type
+        {};
+
+        struct StringCodec
+        {
+            std::size_t size(const std::string &value) const
+            {
+                return value.size();
+            }
+
+            std::size_t encode(const std::string &value, char *data,
+                std::size_t size) const
+            {
+                if(size < value.size())
+                    throw std::length_error("value does not fit the slot");
+                std::memcpy(data, value.data(), value.size());
+                return value.size();
+            }
+
+            std::string decode(const char *data, std::size_t size) const
+            {
+                return std::string(data, size);
+            }
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef XPIPE_STAGE_FUSE_H
+#define XPIPE_STAGE_FUSE_H
+
+#include <utility>
+#include <type_traits>
+
+#include "xpipe/Inlet.h"
+#include "xpipe/inner/StageTraits.h"
+
+namespace xpipe
+{
+    namespace inner
+    {
+        // runs the second stage directly on each value pushed by the first
+        template<class F, class G>
+        class FusedFunc
+        {
+        public:
+            using InType = typename StageTraits<F>::InType;
+            using MidType = typename StageTraits<F>::OutType;
+            using OutType = typename StageTraits<G>::OutType;
+
+        public:
+            FusedFunc(F first, G second)
+                :first(std::move(first)), second(std::move(second))
+            {}
+
+            bool operator()(InType value, xpipe::Inlet<OutType> &inlet)
+            {
+                MidInlet mid(second, inlet);
+                const bool res = first(std::move(value), mid);
+                return res && mid.isRunning();
+            }
+
+        private:
+            class MidInlet final: public xpipe::Inlet<MidType>
+            {
+            public:
+                MidInlet(G &stage, xpipe::Inlet<OutType> &inlet)
+                    :stage(stage), inlet(inlet), running(true)
+                {}
+
+                // values pushed after the second stage is done are dropped
+                void push(MidType value) override
+                {
+                    if(running)
+                        running = stage(std::move(value), inlet);
+                }
+
+                bool isRunning() const
+                {
+                    return running;
+                }
+
+            private:
+                G &stage;
+                xpipe::Inlet<OutType> &inlet;
+                bool running;
+            };
+
+        private:
+            F first;
+            G second;
+        };
+    }
+
+    namespace inner
+    {
+        template<class F, class... Fs>
+        struct FusedType
+        {
+            using Type = FusedFunc<typename std::decay<F>::type,
+                typename FusedType<Fs...>::Type>;
+        };
+
+        template<class F>
+        struct FusedType<F>
+        {
+            using Type = typename std::decay<F>::type;
+        };
+
+        template<class F>
+        typename FusedType<F>::Type fuseAll(F &&f)
+        {
+            return std::forward<F>(f);
+        }
+
+        template<class F, class G, class... Fs>
+        typename FusedType<F, G, Fs...>::Type fuseAll(F &&f, G &&g,
+            Fs&&... fs)
+        {
+            return typename FusedType<F, G, Fs...>::Type(std::forward<F>(f),
+                fuseAll(std::forward<G>(g), std::forward<Fs>(fs)...));
+        }
+    }
+
+    namespace stage
+    {
+        // single map stage doing the work of map(f)>>map(g)>>...
+        template<class F, class G, class... Fs>
+        typename inner::FusedType<F, G, Fs...>::Type fuse(F &&f, G &&g,
+            Fs&&... fs)
+        {
+            return inner::fuseAll(std::forward<F>(f), std::forward<G>(g),
+                std::forward<Fs>(fs)...);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef XPIPE_STAGE_KERNELS_H
+#define XPIPE_STAGE_KERNELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "xpipe/Inlet.h"
+#include "xpipe/inner/kernels.h"
+
+// stages for batchMap, they take a batch of arithmetic values and push
+// their results as one batch, the reductions push theirs at the end
+namespace xpipe
+{
+    namespace stage
+    {
+        // a*value + b
+        template<typename T>
+        class Affine
+        {
+        public:
+            Affine(T a, T b)
+                :a(a), b(b)
+            {}
+
+            bool operator()(std::vector<T> values, xpipe::Inlet<T> &inlet)
+            {
+                inner::kernels::affine(values.data(), values.data(),
+                    values.size(), a, b);
+                inlet.pushBatch(values.data(), values.size());
+                return true;
+            }
+
+        private:
+            T a;
+            T b;
+        };
+
+        template<typename T>
+        class Add: public Affine<T>
+        {
+        public:
+            explicit Add(T value)
+                :Affine<T>(T(1), value)
+            {}
+        };
+
+        template<typename T>
+        class Multiply: public Affine<T>
+        {
+        public:
+            explicit Multiply(T value)
+                :Affine<T>(value, T())
+            {}
+        };
+
+        // keeps the values accepted by the predicate in their order
+        template<typename T, class P>
+        class Filter
+        {
+        public:
+            explicit Filter(P pred)
+                :pred(std::move(pred))
+            {}
+
+            bool operator()(std::vector<T> values, xpipe::Inlet<T> &inlet)
+            {
+                const auto end = std::remove_if(std::begin(values),
+                    std::end(values),
+                    [this](const T &v){return !pred(v);});
+                const auto count =
+                    static_cast<std::size_t>(end - std::begin(values));
+                if(count > 0)
+                    inlet.pushBatch(values.data(), count);
+                return true;
+            }
+
+        private:
+            P pred;
+        };
+
+        template<typename T, class P>
+        Filter<T, P> filter(P pred)
+        {
+            return Filter<T, P>(std::move(pred));
+        }
+
+        // inclusive scan, the running value is kept between the batches
+        template<typename T, class Op = std::plus<T>>
+        class Scan
+        {
+        public:
+            explicit Scan(T init = T(), Op op = Op())
+                :acc(init), op(std::move(op))
+            {}
+
+            bool operator()(std::vector<T> values, xpipe::Inlet<T> &inlet)
+            {
+                for(auto &v : values)
+                {
+                    acc = op(acc, v);
+                    v = acc;
+                }
+                inlet.pushBatch(values.data(), values.size());
+                return true;
+            }
+
+        private:
+            T acc;
+            Op op;
+        };
+
+        template<typename T>
+        using PrefixSum = Scan<T>;
+
+        // the reductions push one value at the end of the input, none if it
+        // is empty, so the result does not depend on the batches, the sum is
+        // taken count values at a time for the rounding to not depend on
+        // them either
+        template<typename T>
+        class Sum
+        {
+        public:
+            explicit Sum(std::size_t count = 1024)
+                :count(count), acc(), pending(), any(false)
+            {
+                if(count == 0)
+                    throw std::invalid_argument("count is 0");
+            }
+
+            bool operator()(std::vector<T> values, xpipe::Inlet<T>&)
+            {
+                any = true;
+                std::size_t pos = 0;
+                while(pos < values.size())
+                {
+                    const auto left = values.size() - pos;
+                    if(pending.empty() && left >= count)
+                    {
+                        acc += inner::kernels::sum(values.data() + pos,
+                            count);
+                        pos += count;
+                        continue;
+                    }
+                    const auto size = std::min(left, count - pending.size());
+                    pending.insert(std::end(pending),
+                        std::begin(values) + static_cast<std::ptrdiff_t>(pos),
+                        std::begin(values) +
+                            static_cast<std::ptrdiff_t>(pos + size));
+                    pos += size;
+                    if(pending.size() == count)
+                        addPending();
+                }
+                return true;
+            }
+
+            void finish(xpipe::Inlet<T> &inlet)
+            {
+                if(!any)
+                    return;
+                addPending();
+                inlet.push(acc);
+            }
+
+        private:
+            void addPending()
+            {
+                if(pending.empty())
+                    return;
+                acc += inner::kernels::sum(pending.data(), pending.size());
+                pending.clear();
+            }
+
+        private:
+            std::size_t count;
+            T acc;
+            // the start of the next count values
+            std::vector<T> pending;
+            bool any;
+        };
+
+        template<typename T>
+        class Min
+        {
+        public:
+            bool operator()(std::vector<T> values, xpipe::Inlet<T>&)
+            {
+                const auto value = inner::kernels::min(values.data(),
+                    values.size());
+                res = any?std::min(res, value):value;
+                any = true;
+                return true;
+            }
+
+            void finish(xpipe::Inlet<T> &inlet)
+            {
+                if(any)
+                    inlet.push(res);
+            }
+
+        private:
+            T res = T();
+            bool any = false;
+        };
+
+        template<typename T>
+        class Max
+        {
+        public:
+            bool operator()(std::vector<T> values, xpipe::Inlet<T>&)
+            {
+                const auto value = inner::kernels::max(values.data(),
+                    values.size());
+                res = any?std::max(res, value):value;
+                any = true;
+                return true;
+            }
+
+            void finish(xpipe::Inlet<T> &inlet)
+            {
+                if(any)
+                    inlet.push(res);
+            }
+
+        private:
+            T res = T();
+            bool any = false;
+        };
+
+        template<typename From, typename To>
+        class Convert
+        {
+        public:
+            bool operator()(std::vector<From> values, xpipe::Inlet<To> &inlet)
+            {
+                converted.resize(values.size());
+                inner::kernels::convert(values.data(), converted.data(),
+                    values.size());
+                inlet.pushBatch(converted.data(), converted.size());
+                return true;
+            }
+
+        private:
+            std::vector<To> converted;
+        };
+    }
+}
+
+#endif
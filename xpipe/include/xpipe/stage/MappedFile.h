@@ -0,0 +1,234 @@
+#ifndef XPIPE_STAGE_MAPPEDFILE_H
+#define XPIPE_STAGE_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+#include "xpipe/Inlet.h"
+
+namespace xpipe
+{
+    namespace stage
+    {
+        // part of a mapped file, it is valid while the stage which pushed
+        // it exists
+        struct Span
+        {
+            const char *data;
+            std::size_t size;
+
+            const char *begin() const
+            {
+                return data;
+            }
+
+            const char *end() const
+            {
+                return data + size;
+            }
+
+            std::string str() const
+            {
+                return std::string(data, size);
+            }
+        };
+
+        // read only mapping of a whole file
+        class MappedFile
+        {
+        public:
+            enum class Advice
+            {
+                Normal,
+                Sequential,
+                Random,
+                WillNeed
+            };
+
+        public:
+            explicit MappedFile(const std::string &path,
+                Advice advice = Advice::Sequential);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile &operator=(const MappedFile&) = delete;
+
+            const char *data() const
+            {
+                return data_;
+            }
+
+            std::size_t size() const
+            {
+                return size_;
+            }
+
+            // the hint for the pages of the range
+            void advise(std::size_t offset, std::size_t size,
+                Advice advice) const;
+
+        private:
+            const char *data_;
+            std::size_t size_;
+        };
+
+        // pushes the spans the file is split into without copying them, at
+        // most batchSize spans at a time, Split returns the size of the next
+        // span and the number of bytes it takes from the rest of the file
+        template<class Split>
+        class MappedSpans
+        {
+        public:
+            MappedSpans(const std::string &path, Split split,
+                std::size_t batchSize, MappedFile::Advice advice)
+                :file(std::make_shared<MappedFile>(path, advice)),
+                split(std::move(split)), batchSize(batchSize), batch()
+            {
+                if(batchSize == 0)
+                    throw std::invalid_argument("batch size is 0");
+            }
+
+            bool operator()(xpipe::Inlet<Span> &inlet)
+            {
+                const auto size = file->size();
+                if(pos == size)
+                    return false;
+                batch.clear();
+                while(pos < size && batch.size() < batchSize)
+                {
+                    const auto *const begin = file->data() + pos;
+                    const auto next = split(begin, size - pos);
+                    batch.push_back(Span{begin, next.first});
+                    pos += next.second;
+                }
+                inlet.pushBatch(batch.data(), batch.size());
+                return true;
+            }
+
+        private:
+            // the copies of the stage share the mapping
+            std::shared_ptr<MappedFile> file;
+            Split split;
+            std::size_t batchSize;
+            std::vector<Span> batch;
+            std::size_t pos = 0;
+        };
+
+        namespace split
+        {
+            // the last record is shorter if the file size is not a multiple
+            // of the record size
+            class Records
+            {
+            public:
+                explicit Records(std::size_t size)
+                    :size(size)
+                {
+                    if(size == 0)
+                        throw std::invalid_argument("record size is 0");
+                }
+
+                std::pair<std::size_t, std::size_t> operator()(
+                    const char*, std::size_t left) const
+                {
+                    const auto res = std::min(size, left);
+                    return std::make_pair(res, res);
+                }
+
+            private:
+                std::size_t size;
+            };
+
+            // the spans do not include the delimiters
+            class Lines
+            {
+            public:
+                explicit Lines(char delimiter)
+                    :delimiter(delimiter)
+                {}
+
+                std::pair<std::size_t, std::size_t> operator()(
+                    const char *data, std::size_t left) const
+                {
+                    const auto *const found = static_cast<const char*>(
+                        std::memchr(data, delimiter, left));
+                    if(!found)
+                        return std::make_pair(left, left);
+                    const auto res = static_cast<std::size_t>(found - data);
+                    return std::make_pair(res, res + 1);
+                }
+
+            private:
+                char delimiter;
+            };
+
+            // spans of whole lines (with their delimiters) of at least size
+            // bytes, a line longer than that makes a longer span
+            class Chunks
+            {
+            public:
+                Chunks(std::size_t size, char delimiter)
+                    :size(size), delimiter(delimiter)
+                {
+                    if(size == 0)
+                        throw std::invalid_argument("chunk size is 0");
+                }
+
+                std::pair<std::size_t, std::size_t> operator()(
+                    const char *data, std::size_t left) const
+                {
+                    if(left <= size)
+                        return std::make_pair(left, left);
+                    const auto *const found = static_cast<const char*>(
+                        std::memchr(data + size - 1, delimiter,
+                            left - size + 1));
+                    const auto res = found?
+                        static_cast<std::size_t>(found - data) + 1:left;
+                    return std::make_pair(res, res);
+                }
+
+            private:
+                std::size_t size;
+                char delimiter;
+            };
+        }
+
+        const std::size_t MAPPED_BATCH_SIZE = 256;
+
+        inline MappedSpans<split::Records> mappedRecords(
+            const std::string &path, std::size_t recordSize,
+            std::size_t batchSize = MAPPED_BATCH_SIZE,
+            MappedFile::Advice advice = MappedFile::Advice::Sequential)
+        {
+            return MappedSpans<split::Records>(path,
+                split::Records(recordSize), batchSize, advice);
+        }
+
+        inline MappedSpans<split::Lines> mappedLines(const std::string &path,
+            char delimiter = '\n', std::size_t batchSize = MAPPED_BATCH_SIZE,
+            MappedFile::Advice advice = MappedFile::Advice::Sequential)
+        {
+            return MappedSpans<split::Lines>(path, split::Lines(delimiter),
+                batchSize, advice);
+        }
+
+        // one chunk at a time, meant for large parts of a file handled in
+        // parallel
+        inline MappedSpans<split::Chunks> mappedChunks(
+            const std::string &path, std::size_t chunkSize,
+            char delimiter = '\n',
+            MappedFile::Advice advice = MappedFile::Advice::Sequential)
+        {
+            return MappedSpans<split::Chunks>(path,
+                split::Chunks(chunkSize, delimiter), 1, advice);
+        }
+    }
+}
+
+#endif
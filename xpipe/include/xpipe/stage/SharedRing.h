@@ -0,0 +1,332 @@
+#ifndef XPIPE_STAGE_SHAREDRING_H
+#define XPIPE_STAGE_SHAREDRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "xpipe/Inlet.h"
+#include "xpipe/Runnable.h"
+#include "xpipe/RunnableSink.h"
+#include "xpipe/stage/Codec.h"
+
+namespace xpipe
+{
+    namespace stage
+    {
+        // one side of a ring of fixed size slots in POSIX shared memory
+        // connecting one writer and one reader, possibly in different
+        // processes, a side is closed when it is destroyed and lost when its
+        // process ends without that
+        class SharedRing
+        {
+        public:
+            enum class Side
+            {
+                Writer,
+                Reader
+            };
+
+        public:
+            // the name is of the form /name
+            static void create(const std::string &name,
+                std::size_t slotCount, std::size_t slotSize);
+            static void remove(const std::string &name);
+
+            SharedRing(const std::string &name, Side side);
+            ~SharedRing();
+
+            SharedRing(const SharedRing&) = delete;
+            SharedRing &operator=(const SharedRing&) = delete;
+
+            std::size_t slotSize() const;
+
+            // nullptr if the ring is full
+            char *slot();
+            // the slot is filled with size bytes
+            void commit(std::size_t size);
+
+            // nullptr if the ring is empty
+            const char *front(std::size_t &size);
+            void pop();
+            // unlike slot and front, they can be called from any thread
+            bool empty() const;
+            bool full() const;
+            bool writerClosed() const;
+            bool readerClosed() const;
+            // whether a wait has found the other side lost
+            bool lost() const;
+            // waits until the ring is not full, the reader is closed or lost
+            // or interrupt is called
+            void waitNotFull();
+            // waits until the ring is not empty, the writer is closed or
+            // lost or interrupt is called
+            void waitNotEmpty();
+            // stops the waits of the side
+            void interrupt();
+
+        private:
+            struct Layout;
+
+        private:
+            static std::size_t slotsOffset();
+            char *slotAt(std::uint64_t pos) const;
+
+        private:
+            Side side;
+            std::size_t mappedSize;
+            Layout *layout;
+            char *slots;
+            std::uint64_t pos;
+            std::uint64_t cached;
+            std::atomic<bool> interrupted;
+            std::atomic<bool> lost_;
+        };
+
+        // writes to a ring, it is not run while the ring is full so the
+        // stages before it are held back the same way as by a full queue, a
+        // thread waits for a free slot meanwhile, it stops once the reader
+        // is closed or lost
+        template<typename T, class Codec = TrivialCodec<T>>
+        class SharedRingOutput: public RunnableSink<T>
+        {
+        public:
+            SharedRingOutput(const std::string &name, Codec codec)
+                :ring(name, SharedRing::Side::Writer), codec(std::move(codec)),
+                outlet(nullptr), waiter(), mutex(), cond(), blocked(false),
+                stopping(false)
+            {
+                if(IsTrivialCodec<Codec>::value && ring.slotSize() < sizeof(T))
+                    throw std::invalid_argument("value does not fit the slots");
+            }
+
+            void init(RunnableOutlet &outlet) override
+            {
+                this->outlet = &outlet;
+                blocked = false;
+                stopping = false;
+                waiter = std::thread(&SharedRingOutput::wait, this);
+            }
+
+            void destroy() override
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                cond.notify_all();
+                ring.interrupt();
+                waiter.join();
+                outlet = nullptr;
+            }
+
+            bool canRun() override
+            {
+                return !ring.full() || ring.readerClosed() || ring.lost();
+            }
+
+            bool run(std::vector<T> &values) override
+            {
+                if(ring.readerClosed() || ring.lost() || values.empty())
+                    return false;
+                std::size_t count = 0;
+                for(; count < values.size(); ++count)
+                {
+                    auto *const slot = ring.slot();
+                    if(!slot)
+                        break;
+                    ring.commit(codec.encode(values[count], slot,
+                            ring.slotSize()));
+                }
+                values.erase(std::begin(values),
+                    std::begin(values) + static_cast<std::ptrdiff_t>(count));
+                // filled up exactly or not
+                if(ring.full())
+                    setBlocked();
+                return true;
+            }
+
+        private:
+            void wait()
+            {
+                while(true)
+                {
+                    ring.waitNotFull();
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if(stopping)
+                            return;
+                    }
+                    outlet->notifyCanRun();
+                    // a stale blocked costs one more notification
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.wait(lock, [this](){
+                            return blocked || stopping;
+                        });
+                    if(stopping)
+                        return;
+                    blocked = false;
+                }
+            }
+
+            void setBlocked()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    blocked = true;
+                }
+                cond.notify_all();
+            }
+
+        private:
+            SharedRing ring;
+            Codec codec;
+            RunnableOutlet *outlet;
+            std::thread waiter;
+            std::mutex mutex;
+            std::condition_variable cond;
+            bool blocked;
+            bool stopping;
+        };
+
+        // pushes the values of a ring until its writer is closed, a thread
+        // waits for the ring to become nonempty while the pipeline has
+        // taken everything, a lost writer fails the stage
+        template<typename T, class Codec = TrivialCodec<T>>
+        class SharedRingInput: public Runnable<T>
+        {
+        public:
+            SharedRingInput(const std::string &name, Codec codec)
+                :ring(name, SharedRing::Side::Reader), codec(std::move(codec)),
+                inlet(nullptr), waiter(), mutex(), cond(), drained(false),
+                stopping(false)
+            {
+                if(IsTrivialCodec<Codec>::value && ring.slotSize() < sizeof(T))
+                    throw std::invalid_argument("value does not fit the slots");
+            }
+
+            void init(RunnableInlet<T> &inlet) override
+            {
+                this->inlet = &inlet;
+                drained = false;
+                stopping = false;
+                waiter = std::thread(&SharedRingInput::wait, this);
+            }
+
+            void destroy() override
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                cond.notify_all();
+                ring.interrupt();
+                waiter.join();
+                inlet = nullptr;
+            }
+
+            bool canRun() override
+            {
+                return !ring.empty() || ring.writerClosed() || ring.lost();
+            }
+
+            bool run() override
+            {
+                std::size_t size = 0;
+                const auto *data = ring.front(size);
+                if(!data)
+                {
+                    // the values written before closing are taken first
+                    if(ring.writerClosed() && !ring.front(size))
+                        return false;
+                    if(ring.lost() && !ring.front(size))
+                        throw std::runtime_error("the writer of the ring "
+                            "is lost");
+                    setDrained();
+                    return true;
+                }
+                // the writer lays the values out the same way, trivial values
+                // are all of their size
+                if(size > ring.slotSize() ||
+                    (IsTrivialCodec<Codec>::value && size != sizeof(T)))
+                    throw std::runtime_error("bad slot");
+                auto value = codec.decode(data, size);
+                ring.pop();
+                if(!ring.front(size))
+                    setDrained();
+                inlet->push(std::move(value));
+                return true;
+            }
+
+        private:
+            void wait()
+            {
+                while(true)
+                {
+                    ring.waitNotEmpty();
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if(stopping)
+                            return;
+                    }
+                    inlet->notifyCanRun();
+                    // a stale drained costs one more notification
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cond.wait(lock, [this](){
+                            return drained || stopping;
+                        });
+                    if(stopping)
+                        return;
+                    drained = false;
+                }
+            }
+
+            void setDrained()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    drained = true;
+                }
+                cond.notify_all();
+            }
+
+        private:
+            SharedRing ring;
+            Codec codec;
+            RunnableInlet<T> *inlet;
+            std::thread waiter;
+            std::mutex mutex;
+            std::condition_variable cond;
+            bool drained;
+            bool stopping;
+        };
+
+        // for use
+        template<typename T, class Codec = TrivialCodec<T>>
+        std::unique_ptr<RunnableSink<T>> sharedRingOutput(
+            const std::string &name, Codec codec = Codec())
+        {
+            return std::unique_ptr<RunnableSink<T>>(
+                new SharedRingOutput<T, Codec>(name, std::move(codec)));
+        }
+
+        // for use
+        template<typename T, class Codec = TrivialCodec<T>>
+        std::unique_ptr<Runnable<T>> sharedRingInput(const std::string &name,
+            Codec codec = Codec())
+        {
+            return std::unique_ptr<Runnable<T>>(
+                new SharedRingInput<T, Codec>(name, std::move(codec)));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,437 @@
+#ifndef XPIPE_STAGE_TCP_H
+#define XPIPE_STAGE_TCP_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "xpipe/Inlet.h"
+#include "xpipe/RunnableSink.h"
+#include "xpipe/Stage.h"
+#include "xpipe/Reactor.h"
+#include "xpipe/stage/Codec.h"
+
+namespace xpipe
+{
+    namespace inner
+    {
+        namespace tcp
+        {
+            // closes the socket when destroyed
+            class Socket
+            {
+            public:
+                explicit Socket(int fd);
+                ~Socket();
+
+                Socket(const Socket&) = delete;
+                Socket &operator=(const Socket&) = delete;
+
+                int get() const
+                {
+                    return fd;
+                }
+
+                // no longer closed
+                int release()
+                {
+                    const int res = fd;
+                    fd = -1;
+                    return res;
+                }
+
+            private:
+                int fd;
+            };
+
+            void setNonBlocking(int fd);
+
+            // a frame is a batch of values: the count, the size of the
+            // payload and the size of each value or 0 if the sizes are
+            // listed after the header, the numbers are big endian
+            const std::size_t HEADER_SIZE = 3*sizeof(std::uint32_t);
+            const std::size_t MAX_FRAME_SIZE = std::size_t(1) << 30;
+
+            inline void putUint32(char *data, std::uint32_t value)
+            {
+                for(int i = 3; i >= 0; --i, value >>= 8)
+                    data[i] = static_cast<char>(value & 0xff);
+            }
+
+            inline std::uint32_t getUint32(const char *data)
+            {
+                std::uint32_t res = 0;
+                for(int i = 0; i < 4; ++i)
+                    res = (res << 8) | static_cast<unsigned char>(data[i]);
+                return res;
+            }
+        }
+    }
+
+    namespace stage
+    {
+        // listening socket, port 0 picks a free one
+        class TcpListener
+        {
+        public:
+            explicit TcpListener(std::uint16_t port = 0,
+                const std::string &address = "0.0.0.0");
+            ~TcpListener();
+
+            TcpListener(const TcpListener&) = delete;
+            TcpListener &operator=(const TcpListener&) = delete;
+
+            std::uint16_t port() const
+            {
+                return port_;
+            }
+
+            // the connected socket is owned by the caller
+            int accept();
+
+        private:
+            int fd;
+            std::uint16_t port_;
+        };
+
+        // the connected socket is owned by the caller
+        int tcpConnect(const std::string &host, std::uint16_t port);
+
+        // sends each batch of values as one frame through the reactor, it
+        // is not run while a frame is being sent so a receiver not reading
+        // holds back the stages before it the same way as a full queue, it
+        // stops once the receiver is closed, the socket is made nonblocking
+        // and is closed with the stage, trivial values are sent from the
+        // batch itself and the others from their encoding
+        template<typename T, class Codec = TrivialCodec<T>>
+        class TcpOutput: public RunnableSink<T>, private Reactor::Handler
+        {
+        public:
+            TcpOutput(Reactor &reactor, int fd, Codec codec)
+                :reactor(reactor), socket(fd), codec(std::move(codec)),
+                outlet(nullptr), header(), sizes(), payload(), batch(),
+                parts(), rest(), mutex(), cond(), request(0), frameSize(0),
+                sent(0), inFlight(false), completing(false), stopping(false),
+                closed(false), error(0)
+            {
+                inner::tcp::setNonBlocking(fd);
+            }
+
+            void init(RunnableOutlet &outlet) override
+            {
+                this->outlet = &outlet;
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = false;
+            }
+
+            void destroy() override
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                stopping = true;
+                // a completion may be about to send the rest of the frame
+                cond.wait(lock, [this](){
+                        return !completing;
+                    });
+                if(inFlight)
+                {
+                    const auto last = request;
+                    lock.unlock();
+                    reactor.cancel(last);
+                    lock.lock();
+                    cond.wait(lock, [this](){
+                            return !inFlight && !completing;
+                        });
+                }
+                outlet = nullptr;
+            }
+
+            bool canRun() override
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                return !inFlight;
+            }
+
+            bool run(std::vector<T> &values) override
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(error != 0)
+                        throw std::system_error(error,
+                            std::generic_category(), "send failed");
+                    // the last frame is sent once it can run again
+                    if(closed || values.empty())
+                        return false;
+                }
+                encode(values);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    sent = 0;
+                    inFlight = true;
+                }
+                submit();
+                return true;
+            }
+
+        private:
+            // takes the values
+            void encode(std::vector<T> &values)
+            {
+                namespace tcp = inner::tcp;
+                const std::size_t elemSize =
+                    IsTrivialCodec<Codec>::value?sizeof(T):0;
+                std::size_t payloadSize = values.size()*elemSize;
+                if(elemSize == 0)
+                {
+                    for(const auto &v : values)
+                        payloadSize += codec.size(v);
+                }
+                sizes.resize(elemSize == 0?
+                    values.size()*sizeof(std::uint32_t):0);
+                frameSize = tcp::HEADER_SIZE + sizes.size() + payloadSize;
+                if(frameSize > tcp::MAX_FRAME_SIZE)
+                    throw std::length_error("batch does not fit a frame");
+                tcp::putUint32(&header[0],
+                    static_cast<std::uint32_t>(values.size()));
+                tcp::putUint32(&header[4],
+                    static_cast<std::uint32_t>(payloadSize));
+                tcp::putUint32(&header[8],
+                    static_cast<std::uint32_t>(elemSize));
+                const void *payloadData = nullptr;
+                if(elemSize != 0)
+                {
+                    // the values are sent as they are, the batch is kept
+                    // until the frame is sent
+                    batch.swap(values);
+                    payloadData = batch.data();
+                }
+                else
+                {
+                    payload.resize(payloadSize);
+                    std::size_t pos = 0;
+                    for(std::size_t i = 0; i < values.size(); ++i)
+                    {
+                        const auto size = codec.encode(values[i],
+                            payload.data() + pos, payloadSize - pos);
+                        tcp::putUint32(&sizes[i*sizeof(std::uint32_t)],
+                            static_cast<std::uint32_t>(size));
+                        pos += size;
+                    }
+                    payloadData = payload.data();
+                }
+                values.clear();
+                parts[0] = iovec{header.data(), header.size()};
+                parts[1] = iovec{sizes.data(), sizes.size()};
+                parts[2] = iovec{const_cast<void*>(payloadData), payloadSize};
+            }
+
+            void complete(long result) override
+            {
+                bool next = false;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(result > 0)
+                        sent += static_cast<std::size_t>(result);
+                    else if(result == -EPIPE || result == -ECONNRESET)
+                        closed = true;
+                    else if(result < 0 && result != -EINTR &&
+                        result != -EAGAIN)
+                        error = static_cast<int>(-result);
+                    next = !closed && error == 0 && !stopping &&
+                        sent < frameSize;
+                    inFlight = next;
+                    completing = true;
+                }
+                if(next)
+                    submit();
+                outlet->notifyCanRun();
+                std::lock_guard<std::mutex> lock(mutex);
+                completing = false;
+                // destroy may return and the stage be gone once the lock is
+                // released
+                cond.notify_all();
+            }
+
+            // a send that can not be started fails the stage
+            void submit()
+            {
+                // the parts sent already are skipped
+                std::size_t skip = sent;
+                std::size_t count = 0;
+                for(const auto &part : parts)
+                {
+                    if(part.iov_len <= skip)
+                    {
+                        skip -= part.iov_len;
+                        continue;
+                    }
+                    rest[count++] = iovec{
+                        static_cast<char*>(part.iov_base) + skip,
+                        part.iov_len - skip};
+                    skip = 0;
+                }
+                try
+                {
+                    const auto id = reactor.send(socket.get(), rest.data(),
+                        count, *this);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    // the send may have completed and the next one started
+                    request = std::max(request, id);
+                }
+                catch(const std::system_error &e)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    inFlight = false;
+                    error = e.code().value();
+                }
+            }
+
+        private:
+            Reactor &reactor;
+            inner::tcp::Socket socket;
+            Codec codec;
+            RunnableOutlet *outlet;
+            std::array<char, inner::tcp::HEADER_SIZE> header;
+            std::vector<char> sizes;
+            // the encoded values
+            std::vector<char> payload;
+            // the trivial values
+            std::vector<T> batch;
+            // the header, the sizes and the payload of the frame
+            std::array<iovec, 3> parts;
+            // what is left of them for the send in flight
+            std::array<iovec, 3> rest;
+            std::mutex mutex;
+            std::condition_variable cond;
+            // the last send started
+            Reactor::Request request;
+            std::size_t frameSize;
+            std::size_t sent;
+            bool inFlight;
+            bool completing;
+            bool stopping;
+            bool closed;
+            int error;
+        };
+
+        // map stage turning the received bytes back into the values, an
+        // empty buffer is the end of the input
+        template<typename T, class Codec = TrivialCodec<T>>
+        class FrameDecoder
+        {
+        public:
+            explicit FrameDecoder(Codec codec = Codec())
+                :codec(std::move(codec)), pending(), values()
+            {}
+
+            bool operator()(std::vector<char> bytes,
+                xpipe::Inlet<T> &inlet)
+            {
+                // the end of the input
+                if(bytes.empty())
+                {
+                    if(!pending.empty())
+                        throw std::runtime_error(
+                            "connection closed within a frame");
+                    return true;
+                }
+                if(pending.empty())
+                    pending = std::move(bytes);
+                else
+                    pending.insert(std::end(pending), std::begin(bytes),
+                        std::end(bytes));
+                std::size_t pos = 0;
+                while(decode(pos))
+                    ;
+                pending.erase(std::begin(pending),
+                    std::begin(pending) + static_cast<std::ptrdiff_t>(pos));
+                if(!values.empty())
+                {
+                    inlet.pushBatch(values.data(), values.size());
+                    values.clear();
+                }
+                return true;
+            }
+
+        private:
+            // false if the frame at pos is not complete
+            bool decode(std::size_t &pos)
+            {
+                namespace tcp = inner::tcp;
+                const auto left = pending.size() - pos;
+                if(left < tcp::HEADER_SIZE)
+                    return false;
+                const auto *const data = pending.data() + pos;
+                const std::size_t count = tcp::getUint32(data);
+                const std::size_t payloadSize = tcp::getUint32(data + 4);
+                const std::size_t elemSize = tcp::getUint32(data + 8);
+                const auto sizesSize =
+                    elemSize == 0?count*sizeof(std::uint32_t):0;
+                const auto frameSize =
+                    tcp::HEADER_SIZE + sizesSize + payloadSize;
+                // the sender lays the values out the same way, trivial
+                // values are all of their size
+                const std::size_t expectedSize =
+                    IsTrivialCodec<Codec>::value?sizeof(T):0;
+                if(frameSize > tcp::MAX_FRAME_SIZE ||
+                    elemSize != expectedSize ||
+                    (elemSize != 0 && count*elemSize != payloadSize))
+                    throw std::runtime_error("bad frame");
+                if(left < frameSize)
+                    return false;
+                const auto *value = data + tcp::HEADER_SIZE + sizesSize;
+                const auto *const end = value + payloadSize;
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                    const std::size_t size = elemSize != 0?elemSize:
+                        tcp::getUint32(data + tcp::HEADER_SIZE +
+                            i*sizeof(std::uint32_t));
+                    if(size > static_cast<std::size_t>(end - value))
+                        throw std::runtime_error("bad frame");
+                    values.push_back(codec.decode(value, size));
+                    value += size;
+                }
+                pos += frameSize;
+                return true;
+            }
+
+        private:
+            Codec codec;
+            std::vector<char> pending;
+            std::vector<T> values;
+        };
+
+        // for use, the socket is owned by the stage
+        template<typename T, class Codec = TrivialCodec<T>>
+        std::unique_ptr<RunnableSink<T>> tcpOutput(Reactor &reactor, int fd,
+            Codec codec = Codec())
+        {
+            return std::unique_ptr<RunnableSink<T>>(
+                new TcpOutput<T, Codec>(reactor, fd, std::move(codec)));
+        }
+
+        // the values sent by a TcpOutput to the connected socket (not
+        // owned), the socket is read through the reactor and not faster
+        // than the pipeline takes the values
+        template<typename T, class Codec = TrivialCodec<T>>
+        OutStage<T> tcpInput(Reactor &reactor, int fd,
+            Codec codec = Codec())
+        {
+            return use(std::unique_ptr<Runnable<std::vector<char>>>(
+                    new ReadRunnable(reactor, fd)))
+                >>map(FrameDecoder<T, Codec>(std::move(codec)));
+        }
+    }
+}
+
+#endif
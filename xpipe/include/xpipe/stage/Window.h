@@ -0,0 +1,388 @@
+#ifndef XPIPE_STAGE_WINDOW_H
+#define XPIPE_STAGE_WINDOW_H
+
+#include <cstddef>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+
+#include "xpipe/Inlet.h"
+
+namespace xpipe
+{
+    namespace stage
+    {
+        // aggregates over the values of a window, a value is added when it
+        // enters the window and removed (oldest first) when it leaves, both
+        // in constant (amortized) time
+        namespace aggregate
+        {
+            template<typename T>
+            class Sum
+            {
+            public:
+                using Result = T;
+
+                void add(const T &value)
+                {
+                    sum += value;
+                }
+
+                // floating point sums drift a little as values are removed
+                void remove(const T &value)
+                {
+                    sum -= value;
+                }
+
+                Result result() const
+                {
+                    return sum;
+                }
+
+                void clear()
+                {
+                    sum = T();
+                }
+
+            private:
+                T sum = T();
+            };
+
+            template<typename T>
+            using RealOf = typename std::conditional<
+                std::is_floating_point<T>::value, T, double>::type;
+
+            template<typename T>
+            class Mean
+            {
+            public:
+                using Result = RealOf<T>;
+
+                void add(const T &value)
+                {
+                    sum.add(static_cast<Result>(value));
+                    ++count;
+                }
+
+                void remove(const T &value)
+                {
+                    sum.remove(static_cast<Result>(value));
+                    --count;
+                }
+
+                Result result() const
+                {
+                    return count > 0?
+                        sum.result()/static_cast<Result>(count):Result();
+                }
+
+                void clear()
+                {
+                    sum.clear();
+                    count = 0;
+                }
+
+            private:
+                Sum<Result> sum;
+                std::size_t count = 0;
+            };
+
+            // population variance, Welford's update run in both directions
+            template<typename T>
+            class Variance
+            {
+            public:
+                using Result = RealOf<T>;
+
+                void add(const T &value)
+                {
+                    const auto v = static_cast<Result>(value);
+                    ++count;
+                    const auto delta = v - mean;
+                    mean += delta/static_cast<Result>(count);
+                    m2 += delta*(v - mean);
+                }
+
+                void remove(const T &value)
+                {
+                    if(count <= 1)
+                    {
+                        clear();
+                        return;
+                    }
+                    const auto v = static_cast<Result>(value);
+                    --count;
+                    const auto delta = v - mean;
+                    mean -= delta/static_cast<Result>(count);
+                    m2 -= delta*(v - mean);
+                }
+
+                Result result() const
+                {
+                    return count > 0?
+                        std::max(Result(), m2)/static_cast<Result>(count):
+                        Result();
+                }
+
+                void clear()
+                {
+                    count = 0;
+                    mean = Result();
+                    m2 = Result();
+                }
+
+            private:
+                std::size_t count = 0;
+                Result mean = Result();
+                Result m2 = Result();
+            };
+
+            // keeps the values that can still become the extremum, the
+            // front is the current one
+            template<typename T, class Compare>
+            class Extremum
+            {
+            public:
+                using Result = T;
+
+                explicit Extremum(Compare comp = Compare())
+                    :comp(std::move(comp)), candidates()
+                {}
+
+                void add(const T &value)
+                {
+                    while(!candidates.empty() &&
+                        comp(value, candidates.back()))
+                        candidates.pop_back();
+                    candidates.push_back(value);
+                }
+
+                void remove(const T &value)
+                {
+                    if(!candidates.empty() &&
+                        !comp(candidates.front(), value) &&
+                        !comp(value, candidates.front()))
+                        candidates.pop_front();
+                }
+
+                // the window is not empty
+                Result result() const
+                {
+                    return candidates.front();
+                }
+
+                void clear()
+                {
+                    candidates.clear();
+                }
+
+            private:
+                Compare comp;
+                std::deque<T> candidates;
+            };
+
+            template<typename T>
+            using Min = Extremum<T, std::less<T>>;
+
+            template<typename T>
+            using Max = Extremum<T, std::greater<T>>;
+        }
+
+        // pushes the aggregate of the last size values every step values,
+        // tumbling windows have step equal to size, the last incomplete
+        // window is not pushed
+        template<typename T, class A>
+        class CountWindow
+        {
+        public:
+            using Result = typename A::Result;
+
+        public:
+            explicit CountWindow(std::size_t size, A aggregate = A())
+                :CountWindow(size, size, std::move(aggregate))
+            {}
+
+            CountWindow(std::size_t size, std::size_t step,
+                A aggregate = A())
+                :size(size), step(step), aggregate(std::move(aggregate)),
+                values()
+            {
+                if(size == 0)
+                    throw std::invalid_argument("window size is 0");
+                if(step == 0)
+                    throw std::invalid_argument("window step is 0");
+                // disjoint windows do not need to remember their values
+                if(step < size)
+                    values.reserve(size);
+            }
+
+            bool operator()(T value, xpipe::Inlet<Result> &inlet)
+            {
+                if(step < size)
+                {
+                    slide(std::move(value));
+                    if(count == size && --untilPush == 0)
+                    {
+                        inlet.push(aggregate.result());
+                        untilPush = step;
+                    }
+                }
+                else if(skip > 0)
+                    --skip;
+                else
+                {
+                    aggregate.add(value);
+                    if(++count == size)
+                    {
+                        inlet.push(aggregate.result());
+                        aggregate.clear();
+                        count = 0;
+                        skip = step - size;
+                    }
+                }
+                return true;
+            }
+
+        private:
+            void slide(T &&value)
+            {
+                aggregate.add(value);
+                if(count < size)
+                {
+                    values.push_back(std::move(value));
+                    ++count;
+                }
+                else
+                {
+                    aggregate.remove(values[oldest]);
+                    values[oldest] = std::move(value);
+                    oldest = (oldest + 1)%size;
+                }
+            }
+
+        private:
+            std::size_t size;
+            std::size_t step;
+            A aggregate;
+            std::vector<T> values;
+            std::size_t oldest = 0;
+            std::size_t count = 0;
+            std::size_t untilPush = 1;
+            std::size_t skip = 0;
+        };
+
+        // event time windows, the input is the time of a value (since any
+        // fixed epoch, not decreasing) and the value, the output is the end
+        // of a window and its aggregate
+        //
+        // the windows are [end - size, end) with ends on the multiples of
+        // step, a window is pushed once a value past its end arrives and
+        // empty ones are not pushed
+        template<typename T, class A,
+                 class Duration = std::chrono::nanoseconds>
+        class TimeWindow
+        {
+        public:
+            using Result = typename A::Result;
+            using In = std::pair<Duration, T>;
+            using Out = std::pair<Duration, Result>;
+
+        public:
+            explicit TimeWindow(Duration size, A aggregate = A())
+                :TimeWindow(size, size, std::move(aggregate))
+            {}
+
+            TimeWindow(Duration size, Duration step, A aggregate = A())
+                :size(size), step(step), aggregate(std::move(aggregate)),
+                values(), end(), started(false)
+            {
+                if(size <= Duration::zero())
+                    throw std::invalid_argument("window size is not positive");
+                if(step <= Duration::zero())
+                    throw std::invalid_argument("window step is not positive");
+            }
+
+            bool operator()(In value, xpipe::Inlet<Out> &inlet)
+            {
+                const auto time = value.first;
+                if(!started)
+                {
+                    end = endAfter(time);
+                    started = true;
+                }
+                if(step < size)
+                    slide(std::move(value), inlet);
+                else
+                    tumble(std::move(value), inlet);
+                return true;
+            }
+
+        private:
+            void slide(In &&value, xpipe::Inlet<Out> &inlet)
+            {
+                while(value.first >= end)
+                {
+                    evictBefore(end - size);
+                    if(values.empty())
+                    {
+                        // skips the empty windows at once
+                        end = endAfter(value.first);
+                        break;
+                    }
+                    inlet.push(Out(end, aggregate.result()));
+                    end += step;
+                }
+                aggregate.add(value.second);
+                values.push_back(std::move(value));
+            }
+
+            // disjoint windows do not need to remember their values
+            void tumble(In &&value, xpipe::Inlet<Out> &inlet)
+            {
+                if(value.first >= end)
+                {
+                    if(count > 0)
+                        inlet.push(Out(end, aggregate.result()));
+                    aggregate.clear();
+                    count = 0;
+                    end = endAfter(value.first);
+                }
+                if(value.first >= end - size)
+                {
+                    aggregate.add(value.second);
+                    ++count;
+                }
+            }
+
+            Duration endAfter(Duration time) const
+            {
+                return (time/step + 1)*step;
+            }
+
+            void evictBefore(Duration time)
+            {
+                while(!values.empty() && values.front().first < time)
+                {
+                    aggregate.remove(values.front().second);
+                    values.pop_front();
+                }
+            }
+
+        private:
+            Duration size;
+            Duration step;
+            A aggregate;
+            std::deque<In> values;
+            std::size_t count = 0;
+            Duration end;
+            bool started;
+        };
+    }
+}
+
+#endif
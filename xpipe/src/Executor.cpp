@@ -0,0 +1,62 @@
+#include "xpipe/Executor.h"
+
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+namespace xpipe
+{
+    Executor::Executor(std::size_t threadCount)
+        :mutex(), cond(), jobs(), stopping(false), threads()
+    {
+        if(threadCount == 0)
+            throw std::invalid_argument("thread count is 0");
+        threads.reserve(threadCount);
+        for(std::size_t i = 0; i < threadCount; ++i)
+            threads.emplace_back(&Executor::work, this);
+    }
+
+    Executor::~Executor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cond.notify_all();
+        for(auto &t : threads)
+            t.join();
+    }
+
+    void Executor::execute(std::function<void()> job)
+    {
+        if(!job)
+            throw std::invalid_argument("job is empty");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(stopping)
+                throw std::runtime_error("executor is stopping");
+            jobs.push_back(std::move(job));
+        }
+        cond.notify_one();
+    }
+
+    void Executor::work()
+    {
+        while(true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [this](){
+                        return stopping || !jobs.empty();
+                    });
+                if(jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            assert(job);
+            job();
+        }
+    }
+}
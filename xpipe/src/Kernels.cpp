@@ -0,0 +1,567 @@
+#include "xpipe/inner/kernels.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define XPIPE_KERNELS_X86
+#include <immintrin.h>
+// sse2 is part of x86-64, avx2 is checked at runtime
+#define XPIPE_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace xpipe
+{
+    namespace inner
+    {
+        namespace kernels
+        {
+            namespace
+            {
+                enum class Reduce
+                {
+                    Sum,
+                    Min,
+                    Max
+                };
+
+                std::atomic<Isa> &currentIsa()
+                {
+                    static std::atomic<Isa> isa(supportedIsa());
+                    return isa;
+                }
+
+                template<Reduce R, typename T>
+                T combine(T left, T right)
+                {
+                    switch(R)
+                    {
+                    case Reduce::Sum:
+                        return left + right;
+                    case Reduce::Min:
+                        return right < left?right:left;
+                    default:
+                        return right > left?right:left;
+                    }
+                }
+
+                template<Reduce R, typename T>
+                T reduceScalar(const T *values, std::size_t count)
+                {
+                    switch(R)
+                    {
+                    case Reduce::Sum:
+                        return kernels::sum<T>(values, count);
+                    case Reduce::Min:
+                        return kernels::min<T>(values, count);
+                    default:
+                        return kernels::max<T>(values, count);
+                    }
+                }
+
+#ifdef XPIPE_KERNELS_X86
+                struct Sse2Float
+                {
+                    using Type = float;
+                    using Reg = __m128;
+                    static constexpr std::size_t WIDTH = 4;
+
+                    static Reg load(const float *p)
+                    {
+                        return _mm_loadu_ps(p);
+                    }
+
+                    static void store(float *p, Reg r)
+                    {
+                        _mm_storeu_ps(p, r);
+                    }
+
+                    static Reg set(float v)
+                    {
+                        return _mm_set1_ps(v);
+                    }
+
+                    static Reg add(Reg l, Reg r)
+                    {
+                        return _mm_add_ps(l, r);
+                    }
+
+                    static Reg mul(Reg l, Reg r)
+                    {
+                        return _mm_mul_ps(l, r);
+                    }
+
+                    static Reg min(Reg l, Reg r)
+                    {
+                        return _mm_min_ps(l, r);
+                    }
+
+                    static Reg max(Reg l, Reg r)
+                    {
+                        return _mm_max_ps(l, r);
+                    }
+                };
+
+                struct Sse2Double
+                {
+                    using Type = double;
+                    using Reg = __m128d;
+                    static constexpr std::size_t WIDTH = 2;
+
+                    static Reg load(const double *p)
+                    {
+                        return _mm_loadu_pd(p);
+                    }
+
+                    static void store(double *p, Reg r)
+                    {
+                        _mm_storeu_pd(p, r);
+                    }
+
+                    static Reg set(double v)
+                    {
+                        return _mm_set1_pd(v);
+                    }
+
+                    static Reg add(Reg l, Reg r)
+                    {
+                        return _mm_add_pd(l, r);
+                    }
+
+                    static Reg mul(Reg l, Reg r)
+                    {
+                        return _mm_mul_pd(l, r);
+                    }
+
+                    static Reg min(Reg l, Reg r)
+                    {
+                        return _mm_min_pd(l, r);
+                    }
+
+                    static Reg max(Reg l, Reg r)
+                    {
+                        return _mm_max_pd(l, r);
+                    }
+                };
+
+                struct Avx2Float
+                {
+                    using Type = float;
+                    using Reg = __m256;
+                    static constexpr std::size_t WIDTH = 8;
+
+                    XPIPE_AVX2 static Reg load(const float *p)
+                    {
+                        return _mm256_loadu_ps(p);
+                    }
+
+                    XPIPE_AVX2 static void store(float *p, Reg r)
+                    {
+                        _mm256_storeu_ps(p, r);
+                    }
+
+                    XPIPE_AVX2 static Reg set(float v)
+                    {
+                        return _mm256_set1_ps(v);
+                    }
+
+                    XPIPE_AVX2 static Reg add(Reg l, Reg r)
+                    {
+                        return _mm256_add_ps(l, r);
+                    }
+
+                    XPIPE_AVX2 static Reg mul(Reg l, Reg r)
+                    {
+                        return _mm256_mul_ps(l, r);
+                    }
+
+                    XPIPE_AVX2 static Reg min(Reg l, Reg r)
+                    {
+                        return _mm256_min_ps(l, r);
+                    }
+
+                    XPIPE_AVX2 static Reg max(Reg l, Reg r)
+                    {
+                        return _mm256_max_ps(l, r);
+                    }
+                };
+
+                struct Avx2Double
+                {
+                    using Type = double;
+                    using Reg = __m256d;
+                    static constexpr std::size_t WIDTH = 4;
+
+                    XPIPE_AVX2 static Reg load(const double *p)
+                    {
+                        return _mm256_loadu_pd(p);
+                    }
+
+                    XPIPE_AVX2 static void store(double *p, Reg r)
+                    {
+                        _mm256_storeu_pd(p, r);
+                    }
+
+                    XPIPE_AVX2 static Reg set(double v)
+                    {
+                        return _mm256_set1_pd(v);
+                    }
+
+                    XPIPE_AVX2 static Reg add(Reg l, Reg r)
+                    {
+                        return _mm256_add_pd(l, r);
+                    }
+
+                    XPIPE_AVX2 static Reg mul(Reg l, Reg r)
+                    {
+                        return _mm256_mul_pd(l, r);
+                    }
+
+                    XPIPE_AVX2 static Reg min(Reg l, Reg r)
+                    {
+                        return _mm256_min_pd(l, r);
+                    }
+
+                    XPIPE_AVX2 static Reg max(Reg l, Reg r)
+                    {
+                        return _mm256_max_pd(l, r);
+                    }
+                };
+
+                // the loops are the same for both instruction sets, they are
+                // written twice as the target of a function can not come
+                // from its template arguments
+                template<class V>
+                void affineSse2(const typename V::Type *in,
+                    typename V::Type *out, std::size_t count,
+                    typename V::Type a, typename V::Type b)
+                {
+                    const auto va = V::set(a);
+                    const auto vb = V::set(b);
+                    std::size_t i = 0;
+                    for(; i + V::WIDTH <= count; i += V::WIDTH)
+                        V::store(out + i,
+                            V::add(V::mul(va, V::load(in + i)), vb));
+                    kernels::affine<typename V::Type>(in + i, out + i,
+                        count - i, a, b);
+                }
+
+                template<class V>
+                XPIPE_AVX2 void affineAvx2(const typename V::Type *in,
+                    typename V::Type *out, std::size_t count,
+                    typename V::Type a, typename V::Type b)
+                {
+                    const auto va = V::set(a);
+                    const auto vb = V::set(b);
+                    std::size_t i = 0;
+                    for(; i + V::WIDTH <= count; i += V::WIDTH)
+                        V::store(out + i,
+                            V::add(V::mul(va, V::load(in + i)), vb));
+                    kernels::affine<typename V::Type>(in + i, out + i,
+                        count - i, a, b);
+                }
+
+                template<class V, Reduce R>
+                typename V::Reg combineReg(typename V::Reg l, typename V::Reg r)
+                {
+                    switch(R)
+                    {
+                    case Reduce::Sum:
+                        return V::add(l, r);
+                    case Reduce::Min:
+                        return V::min(l, r);
+                    default:
+                        return V::max(l, r);
+                    }
+                }
+
+                template<class V, Reduce R>
+                XPIPE_AVX2 typename V::Reg combineRegAvx2(typename V::Reg l,
+                    typename V::Reg r)
+                {
+                    switch(R)
+                    {
+                    case Reduce::Sum:
+                        return V::add(l, r);
+                    case Reduce::Min:
+                        return V::min(l, r);
+                    default:
+                        return V::max(l, r);
+                    }
+                }
+
+                template<class V, Reduce R>
+                typename V::Type reduceSse2(const typename V::Type *values,
+                    std::size_t count)
+                {
+                    using T = typename V::Type;
+                    if(count < V::WIDTH)
+                        return reduceScalar<R>(values, count);
+                    auto acc = V::load(values);
+                    std::size_t i = V::WIDTH;
+                    for(; i + V::WIDTH <= count; i += V::WIDTH)
+                        acc = combineReg<V, R>(acc, V::load(values + i));
+                    T lanes[V::WIDTH];
+                    V::store(lanes, acc);
+                    T res = lanes[0];
+                    for(std::size_t l = 1; l < V::WIDTH; ++l)
+                        res = combine<R>(res, lanes[l]);
+                    for(; i < count; ++i)
+                        res = combine<R>(res, values[i]);
+                    return res;
+                }
+
+                template<class V, Reduce R>
+                XPIPE_AVX2 typename V::Type reduceAvx2(
+                    const typename V::Type *values, std::size_t count)
+                {
+                    using T = typename V::Type;
+                    if(count < V::WIDTH)
+                        return reduceScalar<R>(values, count);
+                    auto acc = V::load(values);
+                    std::size_t i = V::WIDTH;
+                    for(; i + V::WIDTH <= count; i += V::WIDTH)
+                        acc = combineRegAvx2<V, R>(acc, V::load(values + i));
+                    T lanes[V::WIDTH];
+                    V::store(lanes, acc);
+                    T res = lanes[0];
+                    for(std::size_t l = 1; l < V::WIDTH; ++l)
+                        res = combine<R>(res, lanes[l]);
+                    for(; i < count; ++i)
+                        res = combine<R>(res, values[i]);
+                    return res;
+                }
+
+                void convertSse2(const float *in, double *out,
+                    std::size_t count)
+                {
+                    std::size_t i = 0;
+                    for(; i + 4 <= count; i += 4)
+                    {
+                        const auto v = _mm_loadu_ps(in + i);
+                        _mm_storeu_pd(out + i, _mm_cvtps_pd(v));
+                        _mm_storeu_pd(out + i + 2,
+                            _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+                    }
+                    kernels::convert<float, double>(in + i, out + i, count - i);
+                }
+
+                XPIPE_AVX2 void convertAvx2(const float *in, double *out,
+                    std::size_t count)
+                {
+                    std::size_t i = 0;
+                    for(; i + 4 <= count; i += 4)
+                        _mm256_storeu_pd(out + i,
+                            _mm256_cvtps_pd(_mm_loadu_ps(in + i)));
+                    kernels::convert<float, double>(in + i, out + i, count - i);
+                }
+
+                void convertSse2(const double *in, float *out,
+                    std::size_t count)
+                {
+                    std::size_t i = 0;
+                    for(; i + 4 <= count; i += 4)
+                    {
+                        const auto lo = _mm_cvtpd_ps(_mm_loadu_pd(in + i));
+                        const auto hi = _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2));
+                        _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+                    }
+                    kernels::convert<double, float>(in + i, out + i, count - i);
+                }
+
+                XPIPE_AVX2 void convertAvx2(const double *in, float *out,
+                    std::size_t count)
+                {
+                    std::size_t i = 0;
+                    for(; i + 4 <= count; i += 4)
+                        _mm_storeu_ps(out + i,
+                            _mm256_cvtpd_ps(_mm256_loadu_pd(in + i)));
+                    kernels::convert<double, float>(in + i, out + i, count - i);
+                }
+
+                void convertSse2(const std::int32_t *in, double *out,
+                    std::size_t count)
+                {
+                    std::size_t i = 0;
+                    for(; i + 2 <= count; i += 2)
+                        _mm_storeu_pd(out + i, _mm_cvtepi32_pd(_mm_loadl_epi64(
+                                    reinterpret_cast<const __m128i*>(in + i))));
+                    kernels::convert<std::int32_t, double>(in + i, out + i,
+                        count - i);
+                }
+
+                XPIPE_AVX2 void convertAvx2(const std::int32_t *in,
+                    double *out, std::size_t count)
+                {
+                    std::size_t i = 0;
+                    for(; i + 4 <= count; i += 4)
+                        _mm256_storeu_pd(out + i,
+                            _mm256_cvtepi32_pd(_mm_loadu_si128(
+                                    reinterpret_cast<const __m128i*>(in + i))));
+                    kernels::convert<std::int32_t, double>(in + i, out + i,
+                        count - i);
+                }
+#endif
+
+                template<class Sse2, class Avx2>
+                void dispatchAffine(const typename Sse2::Type *in,
+                    typename Sse2::Type *out, std::size_t count,
+                    typename Sse2::Type a, typename Sse2::Type b)
+                {
+#ifdef XPIPE_KERNELS_X86
+                    switch(activeIsa())
+                    {
+                    case Isa::Avx2:
+                        affineAvx2<Avx2>(in, out, count, a, b);
+                        return;
+                    case Isa::Sse2:
+                        affineSse2<Sse2>(in, out, count, a, b);
+                        return;
+                    default:
+                        break;
+                    }
+#endif
+                    kernels::affine<typename Sse2::Type>(in, out, count, a, b);
+                }
+
+                template<class Sse2, class Avx2, Reduce R>
+                typename Sse2::Type dispatchReduce(
+                    const typename Sse2::Type *values, std::size_t count)
+                {
+#ifdef XPIPE_KERNELS_X86
+                    switch(activeIsa())
+                    {
+                    case Isa::Avx2:
+                        return reduceAvx2<Avx2, R>(values, count);
+                    case Isa::Sse2:
+                        return reduceSse2<Sse2, R>(values, count);
+                    default:
+                        break;
+                    }
+#endif
+                    return reduceScalar<R>(values, count);
+                }
+
+                template<typename From, typename To>
+                void dispatchConvert(const From *in, To *out,
+                    std::size_t count)
+                {
+#ifdef XPIPE_KERNELS_X86
+                    switch(activeIsa())
+                    {
+                    case Isa::Avx2:
+                        convertAvx2(in, out, count);
+                        return;
+                    case Isa::Sse2:
+                        convertSse2(in, out, count);
+                        return;
+                    default:
+                        break;
+                    }
+#endif
+                    kernels::convert<From, To>(in, out, count);
+                }
+
+#ifndef XPIPE_KERNELS_X86
+                // the vector types are only named by the dispatch
+                struct Sse2Float { using Type = float; };
+                struct Sse2Double { using Type = double; };
+                using Avx2Float = Sse2Float;
+                using Avx2Double = Sse2Double;
+#endif
+            }
+
+            Isa supportedIsa()
+            {
+#ifdef XPIPE_KERNELS_X86
+                __builtin_cpu_init();
+                if(__builtin_cpu_supports("avx2"))
+                    return Isa::Avx2;
+                return Isa::Sse2;
+#else
+                return Isa::Scalar;
+#endif
+            }
+
+            Isa activeIsa()
+            {
+                return currentIsa();
+            }
+
+            void setIsa(Isa isa)
+            {
+                const auto supported = supportedIsa();
+                currentIsa() =
+                    static_cast<int>(isa) < static_cast<int>(supported)?
+                    isa:supported;
+            }
+
+            void affine(const float *in, float *out, std::size_t count,
+                float a, float b)
+            {
+                dispatchAffine<Sse2Float, Avx2Float>(in, out, count, a, b);
+            }
+
+            void affine(const double *in, double *out, std::size_t count,
+                double a, double b)
+            {
+                dispatchAffine<Sse2Double, Avx2Double>(in, out, count, a, b);
+            }
+
+            float sum(const float *values, std::size_t count)
+            {
+                return dispatchReduce<Sse2Float, Avx2Float, Reduce::Sum>(
+                    values, count);
+            }
+
+            double sum(const double *values, std::size_t count)
+            {
+                return dispatchReduce<Sse2Double, Avx2Double, Reduce::Sum>(
+                    values, count);
+            }
+
+            float min(const float *values, std::size_t count)
+            {
+                assert(count > 0);
+                return dispatchReduce<Sse2Float, Avx2Float, Reduce::Min>(
+                    values, count);
+            }
+
+            double min(const double *values, std::size_t count)
+            {
+                assert(count > 0);
+                return dispatchReduce<Sse2Double, Avx2Double, Reduce::Min>(
+                    values, count);
+            }
+
+            float max(const float *values, std::size_t count)
+            {
+                assert(count > 0);
+                return dispatchReduce<Sse2Float, Avx2Float, Reduce::Max>(
+                    values, count);
+            }
+
+            double max(const double *values, std::size_t count)
+            {
+                assert(count > 0);
+                return dispatchReduce<Sse2Double, Avx2Double, Reduce::Max>(
+                    values, count);
+            }
+
+            void convert(const float *in, double *out, std::size_t count)
+            {
+                dispatchConvert(in, out, count);
+            }
+
+            void convert(const double *in, float *out, std::size_t count)
+            {
+                dispatchConvert(in, out, count);
+            }
+
+            void convert(const std::int32_t *in, double *out,
+                std::size_t count)
+            {
+                dispatchConvert(in, out, count);
+            }
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#include "xpipe/stage/MappedFile.h"
+
+#include <cassert>
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace xpipe
+{
+    namespace stage
+    {
+        namespace
+        {
+            int toMadvise(MappedFile::Advice advice)
+            {
+                switch(advice)
+                {
+                case MappedFile::Advice::Sequential:
+                    return MADV_SEQUENTIAL;
+                case MappedFile::Advice::Random:
+                    return MADV_RANDOM;
+                case MappedFile::Advice::WillNeed:
+                    return MADV_WILLNEED;
+                default:
+                    return MADV_NORMAL;
+                }
+            }
+
+            std::system_error lastError(const std::string &what)
+            {
+                return std::system_error(errno, std::generic_category(),
+                    what);
+            }
+
+            class FileDescriptor
+            {
+            public:
+                explicit FileDescriptor(const std::string &path)
+                    :fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC))
+                {
+                    if(fd < 0)
+                        throw lastError("failed to open " + path);
+                }
+
+                ~FileDescriptor()
+                {
+                    ::close(fd);
+                }
+
+                FileDescriptor(const FileDescriptor&) = delete;
+                FileDescriptor &operator=(const FileDescriptor&) = delete;
+
+                int get() const
+                {
+                    return fd;
+                }
+
+            private:
+                int fd;
+            };
+        }
+
+        MappedFile::MappedFile(const std::string &path, Advice advice)
+            :data_(nullptr), size_(0)
+        {
+            FileDescriptor fd(path);
+            struct stat st;
+            if(::fstat(fd.get(), &st) != 0)
+                throw lastError("failed to stat " + path);
+            size_ = static_cast<std::size_t>(st.st_size);
+            // an empty mapping is not allowed
+            if(size_ == 0)
+                return;
+            void *const res = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE,
+                fd.get(), 0);
+            if(res == MAP_FAILED)
+                throw lastError("failed to map " + path);
+            data_ = static_cast<const char*>(res);
+            advise(0, size_, advice);
+        }
+
+        MappedFile::~MappedFile()
+        {
+            if(data_)
+                ::munmap(const_cast<char*>(data_), size_);
+        }
+
+        void MappedFile::advise(std::size_t offset, std::size_t size,
+            Advice advice) const
+        {
+            assert(offset + size <= size_);
+            if(size == 0)
+                return;
+            // the range has to start on a page
+            const auto page =
+                static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            const auto begin = offset/page*page;
+            // only a hint, failures are ignored
+            ::madvise(const_cast<char*>(data_) + begin, offset + size - begin,
+                toMadvise(advice));
+        }
+    }
+}
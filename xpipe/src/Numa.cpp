@@ -0,0 +1,179 @@
+#include "Numa.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace xpipe
+{
+    namespace numa
+    {
+        namespace
+        {
+            const char *const NODE_PATH = "/sys/devices/system/node";
+            const std::size_t WORD_BITS = sizeof(unsigned long)*CHAR_BIT;
+
+            // lists like 0-3,8,10-11
+            std::vector<int> parseCpuList(const std::string &list)
+            {
+                std::vector<int> res;
+                std::istringstream stream(list);
+                std::string range;
+                while(std::getline(stream, range, ','))
+                {
+                    int first = 0;
+                    int last = 0;
+                    const auto dash = range.find('-');
+                    try
+                    {
+                        first = std::stoi(range.substr(0, dash));
+                        last = dash == std::string::npos?first:
+                            std::stoi(range.substr(dash + 1));
+                    }
+                    catch(const std::logic_error&)
+                    {
+                        continue;
+                    }
+                    for(int cpu = first; cpu <= last; ++cpu)
+                        res.push_back(cpu);
+                }
+                return res;
+            }
+
+            bool nodeIndex(const char *name, int &node)
+            {
+                if(std::strncmp(name, "node", 4) != 0 || name[4] == '\0')
+                    return false;
+                char *end = nullptr;
+                const auto value = std::strtol(name + 4, &end, 10);
+                if(*end != '\0' || value < 0 || value > INT_MAX)
+                    return false;
+                node = static_cast<int>(value);
+                return true;
+            }
+        }
+
+        Topology readTopology()
+        {
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            if(::sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+                throw std::system_error(errno, std::generic_category(),
+                    "failed to get the cpus");
+            Topology res;
+            if(auto *const dir = ::opendir(NODE_PATH))
+            {
+                while(auto *const entry = ::readdir(dir))
+                {
+                    int node = 0;
+                    if(!nodeIndex(entry->d_name, node))
+                        continue;
+                    std::ifstream file(std::string(NODE_PATH) + "/" +
+                        entry->d_name + "/cpulist");
+                    std::string list;
+                    std::getline(file, list);
+                    for(const auto cpu : parseCpuList(list))
+                    {
+                        if(cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                            res[node].push_back(cpu);
+                    }
+                }
+                ::closedir(dir);
+            }
+            if(res.empty())
+            {
+                for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                {
+                    if(CPU_ISSET(cpu, &allowed))
+                        res[0].push_back(cpu);
+                }
+            }
+            return res;
+        }
+
+        std::vector<Place> placeWorkers(const Topology &topology,
+            std::size_t workerCount)
+        {
+            std::vector<Place> res;
+            if(topology.empty())
+                return res;
+            std::map<int, std::size_t> used;
+            auto node = std::begin(topology);
+            while(res.size() < workerCount)
+            {
+                auto &count = used[node->first];
+                const auto &cpus = node->second;
+                res.push_back(Place{cpus[count%cpus.size()], node->first});
+                ++count;
+                if(++node == std::end(topology))
+                    node = std::begin(topology);
+            }
+            return res;
+        }
+
+        CpuPin::CpuPin(int cpu)
+            :pinned(false), previous()
+        {
+            if(cpu < 0)
+                return;
+            const auto self = ::pthread_self();
+            int res = ::pthread_getaffinity_np(self, sizeof(previous),
+                &previous);
+            if(res == 0)
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                res = ::pthread_setaffinity_np(self, sizeof(set), &set);
+            }
+            if(res != 0)
+                throw std::system_error(res, std::generic_category(),
+                    "failed to pin the worker to cpu " + std::to_string(cpu));
+            pinned = true;
+        }
+
+        CpuPin::~CpuPin()
+        {
+            if(pinned)
+                ::pthread_setaffinity_np(::pthread_self(), sizeof(previous),
+                    &previous);
+        }
+
+        // libnuma is not needed for the two calls, without NUMA support in
+        // the kernel they fail and the memory goes where it would anyway
+        PreferredNode::PreferredNode(int node)
+            :set(false), previousMode(MPOL_DEFAULT), previousMask()
+        {
+            const auto bits = MASK_WORDS*WORD_BITS;
+            if(node < 0 || static_cast<std::size_t>(node) >= bits)
+                return;
+            if(::syscall(SYS_get_mempolicy, &previousMode, previousMask,
+                    bits, nullptr, 0) != 0)
+                return;
+            unsigned long mask[MASK_WORDS] = {};
+            const auto bit = static_cast<std::size_t>(node);
+            mask[bit/WORD_BITS] = 1ul << (bit%WORD_BITS);
+            set = ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask,
+                bits) == 0;
+        }
+
+        PreferredNode::~PreferredNode()
+        {
+            if(set)
+                ::syscall(SYS_set_mempolicy, previousMode, previousMask,
+                    MASK_WORDS*WORD_BITS);
+        }
+    }
+}
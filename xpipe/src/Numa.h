@@ -0,0 +1,68 @@
+#ifndef XPIPE_NUMA_H
+#define XPIPE_NUMA_H
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include <sched.h>
+
+namespace xpipe
+{
+    namespace numa
+    {
+        // the cpus the process may run on by their NUMA node, all of them
+        // are on node 0 when the topology is not known
+        using Topology = std::map<int, std::vector<int>>;
+
+        Topology readTopology();
+
+        struct Place
+        {
+            int cpu;
+            int node;
+        };
+
+        // the workers go to the nodes in turn so each node has some once
+        // there are enough of them, the cpus are shared when there are not
+        std::vector<Place> placeWorkers(const Topology &topology,
+            std::size_t workerCount);
+
+        // pins the calling thread while it exists, -1 leaves it as it is
+        class CpuPin
+        {
+        public:
+            explicit CpuPin(int cpu);
+            ~CpuPin();
+
+            CpuPin(const CpuPin&) = delete;
+            CpuPin &operator=(const CpuPin&) = delete;
+
+        private:
+            bool pinned;
+            cpu_set_t previous;
+        };
+
+        // the memory the calling thread allocates while it exists comes
+        // from the node while it has some, -1 leaves the policy as it is
+        class PreferredNode
+        {
+        public:
+            explicit PreferredNode(int node);
+            ~PreferredNode();
+
+            PreferredNode(const PreferredNode&) = delete;
+            PreferredNode &operator=(const PreferredNode&) = delete;
+
+        private:
+            static const std::size_t MASK_WORDS = 16;
+
+        private:
+            bool set;
+            int previousMode;
+            unsigned long previousMask[MASK_WORDS];
+        };
+    }
+}
+
+#endif
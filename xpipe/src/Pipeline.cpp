@@ -5,9 +5,18 @@
 #include <stdexcept>
 #include <queue>
 #include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <utility>
+#include <fstream>
+#include <map>
+#include <string>
 
 #include "xpipe/inner/Task.h"
 #include "xpipe/inner/Node.h"
+#include "xpipe/Executor.h"
+#include "Numa.h"
 #include "Scheduler.h"
 
 namespace xpipe
@@ -46,70 +55,388 @@ namespace xpipe
                 }
             }
         }
+
+        PipelineOptions withThreadCount(std::size_t threadCount)
+        {
+            PipelineOptions options;
+            options.threadCount = threadCount;
+            return options;
+        }
     }
 
     Pipeline::Pipeline(const BaseStage &stages)
-        :Pipeline(stages, std::thread::hardware_concurrency())
+        :Pipeline(stages, PipelineOptions())
     {}
 
     Pipeline::Pipeline(const BaseStage &stages, std::size_t threadCount)
-        :threadCount(threadCount), node(stages.getNode()),
-        scheduler(new Scheduler(stages.getNode()))
+        :Pipeline(stages, withThreadCount(threadCount))
+    {}
+
+    Pipeline::Pipeline(const BaseStage &stages, const PipelineOptions &options)
+        :threadCount(options.threadCount), workerCount(0),
+        executor(options.executor),
+        tracePath(options.tracePath), workerCpus(),
+        node(stages.getNode()), threads(), failure(), executorRun(),
+        asyncThread(), asyncMutex(), asyncCond(), asyncRunning(false)
     {
         if(threadCount == 0)
             throw std::invalid_argument("thread count is 0");
+        // the threads of the groups follow the shared workers
+        Scheduler::WorkerLayout layout;
+        layout.groups.assign(threadCount + 1, 0);
+        std::map<std::string, std::size_t> groupIds;
+        for(const auto &group : options.threadGroups)
+        {
+            if(group.second == 0)
+                throw std::invalid_argument("thread group " + group.first +
+                    " is empty");
+            const auto id = groupIds.size() + 1;
+            groupIds[group.first] = id;
+            layout.groups.insert(std::end(layout.groups), group.second, id);
+        }
+        traverseTasks(*node, [&layout, &groupIds](inner::Task &task) {
+                if(task.hasDedicatedThread())
+                {
+                    const auto id = groupIds.size() + layout.taskGroups.size()
+                        + 1;
+                    layout.groups.push_back(id);
+                    layout.taskGroups[&task] = id;
+                }
+                else if(!task.getThreadGroup().empty())
+                {
+                    const auto group = groupIds.find(task.getThreadGroup());
+                    if(group == std::end(groupIds))
+                        throw std::invalid_argument("no thread group " +
+                            task.getThreadGroup());
+                    layout.taskGroups[&task] = group->second;
+                }
+            });
+        workerCount = layout.groups.size();
+        std::unordered_set<int> nodes;
+        if(options.pinWorkers && !executor)
+        {
+            for(const auto &place : numa::placeWorkers(numa::readTopology(),
+                    workerCount))
+            {
+                workerCpus.push_back(place.cpu);
+                layout.nodes.push_back(place.node);
+                nodes.insert(place.node);
+            }
+        }
+        traverseTasks(*node, [&options, &nodes](inner::Task &task) {
+                // the queues allocated here are on the node of the task
+                numa::PreferredNode preferred(
+                    nodes.count(task.getNode()) != 0?task.getNode():-1);
+                task.configure(options);
+                if(options.statistics)
+                    task.enableCounters();
+            });
+        scheduler.reset(new Scheduler(stages.getNode(), workerCount,
+                options.scheduling, !options.tracePath.empty(), layout,
+                options.waiting));
+        if(executor)
+        {
+            scheduler->setResume([this](std::size_t worker){
+                    auto run = executorRun;
+                    executor->execute([this, run, worker](){
+                            work(run, worker);
+                        });
+                });
+        }
     }
 
     Pipeline::~Pipeline()
-    {}
+    {
+        waitAsync();
+        if(asyncThread.joinable())
+            asyncThread.join();
+    }
 
     void Pipeline::run()
     {
-        auto task = node;
-        assert(task);
-        traverseTasks(*task, [](inner::Task &task) {
-                task.init();
+        if(executor)
+        {
+            runOnExecutor(false).get();
+            return;
+        }
+        startRun();
+        startThreads(1);
+        Routine(*scheduler, 0, failure, cpuOf(0))();
+        endRun();
+    }
+
+    std::future<void> Pipeline::runAsync()
+    {
+        beginAsync();
+        try
+        {
+            if(executor)
+                return runOnExecutor(true);
+            auto promise = std::make_shared<std::promise<void>>();
+            auto res = promise->get_future();
+            asyncThread = std::thread([this, promise](){
+                    std::exception_ptr error;
+                    try
+                    {
+                        run();
+                    }
+                    catch(...)
+                    {
+                        error = std::current_exception();
+                    }
+                    // the next run may start once the result is got
+                    endAsync();
+                    if(error)
+                        promise->set_exception(error);
+                    else
+                        promise->set_value();
+                });
+            return res;
+        }
+        catch(...)
+        {
+            endAsync();
+            throw;
+        }
+    }
+
+    void Pipeline::stop()
+    {
+        assert(scheduler);
+        scheduler->stop();
+    }
+
+    PipelineStatistics Pipeline::statistics() const
+    {
+        PipelineStatistics res;
+        auto root = node;
+        assert(root);
+        traverseTasks(*root, [&res](inner::Task &task) {
+                const auto *counters = task.getCounters();
+                if(counters)
+                    res.push_back(counters->snapshot());
             });
-        scheduler->start();
-        Routine routine(*scheduler);
-        for(std::size_t i = 0; i < threadCount; ++i)
+        return res;
+    }
+
+    void Pipeline::writeTrace()
+    {
+        std::ofstream stream(tracePath.c_str());
+        if(!stream)
+            throw std::runtime_error("cannot open trace " + tracePath);
+        scheduler->writeTrace(stream);
+        if(!stream)
+            throw std::runtime_error("cannot write trace " + tracePath);
+    }
+
+    int Pipeline::cpuOf(std::size_t worker) const
+    {
+        return workerCpus.empty()?-1:workerCpus[worker];
+    }
+
+    void Pipeline::startThreads(std::size_t first)
+    {
+        for(auto i = first; i < workerCount; ++i)
         {
-            threads.push_back(std::make_shared<std::thread>(routine));
+            threads.push_back(std::make_shared<std::thread>(
+                    Routine(*scheduler, i, failure, cpuOf(i))));
         }
-        routine();
+    }
+
+    void Pipeline::joinThreads()
+    {
         for(auto &t : threads)
         {
             assert(t);
             t->join();
         }
         threads.clear();
+    }
+
+    void Pipeline::startRun()
+    {
+        auto task = node;
+        assert(task);
+        traverseTasks(*task, [](inner::Task &task) {
+                task.init();
+            });
+        scheduler->start();
+    }
+
+    void Pipeline::endRun()
+    {
+        joinThreads();
         traverseTasks(*node, [](inner::Task &task) {
                 task.destroy();
             });
+        std::exception_ptr error;
+        std::swap(error, failure.error);
+        if(!tracePath.empty())
+        {
+            // the failure of a stage goes first
+            try
+            {
+                writeTrace();
+            }
+            catch(...)
+            {
+                if(!error)
+                    throw;
+            }
+        }
+        if(error)
+            std::rethrow_exception(error);
     }
 
-    void Pipeline::stop()
+    std::future<void> Pipeline::runOnExecutor(bool async)
     {
-        assert(scheduler);
-        scheduler->stop();
+        assert(executor);
+        // the shared workers are the executor jobs, their count is that of
+        // the calling worker and the threads without the executor
+        const auto sharedCount = threadCount + 1;
+        auto run = std::make_shared<ExecutorRun>();
+        run->active = sharedCount;
+        run->async = async;
+        auto res = run->promise.get_future();
+        executorRun = run;
+        startRun();
+        // the threads of the groups are never shared
+        startThreads(sharedCount);
+        for(std::size_t i = 0; i < sharedCount; ++i)
+        {
+            executor->execute([this, run, i](){
+                    work(run, i);
+                });
+        }
+        return res;
+    }
+
+    void Pipeline::work(std::shared_ptr<ExecutorRun> run, std::size_t worker)
+    {
+        if(Routine(*scheduler, worker, failure).poll() || --run->active > 0)
+            return;
+        std::exception_ptr error;
+        try
+        {
+            endRun();
+        }
+        catch(...)
+        {
+            error = std::current_exception();
+        }
+        // the pipeline may be gone once the run is over
+        if(run->async)
+            endAsync();
+        if(error)
+            run->promise.set_exception(error);
+        else
+            run->promise.set_value();
+    }
+
+    void Pipeline::beginAsync()
+    {
+        {
+            std::lock_guard<std::mutex> lock(asyncMutex);
+            if(asyncRunning)
+                throw std::runtime_error("pipeline is running");
+            asyncRunning = true;
+        }
+        if(asyncThread.joinable())
+            asyncThread.join();
+    }
+
+    void Pipeline::endAsync()
+    {
+        std::lock_guard<std::mutex> lock(asyncMutex);
+        asyncRunning = false;
+        asyncCond.notify_all();
+    }
+
+    void Pipeline::waitAsync()
+    {
+        std::unique_lock<std::mutex> lock(asyncMutex);
+        asyncCond.wait(lock, [this](){
+                return !asyncRunning;
+            });
     }
 
     void Pipeline::Routine::operator()()
+    {
+        assert(failure);
+        try
+        {
+            numa::CpuPin pin(cpu);
+            loop();
+        }
+        catch(...)
+        {
+            fail();
+        }
+    }
+
+    bool Pipeline::Routine::poll()
     {
         assert(scheduler);
-        while(true)
+        try
         {
-            auto *task = scheduler->takeTask();
-            if(task)
+            while(true)
             {
-                while(task->run())
-                    ;
-                scheduler->putTask(task);
+                auto *task = scheduler->tryTakeTask(worker);
+                if(task)
+                    runTask(task);
+                else if(scheduler->isOver())
+                    return false;
+                else if(scheduler->park(worker))
+                    return true;
             }
+        }
+        catch(...)
+        {
+            fail();
+        }
+        return false;
+    }
+
+    void Pipeline::Routine::loop()
+    {
+        assert(scheduler);
+        while(true)
+        {
+            auto *task = scheduler->takeTask(worker);
+            if(task)
+                runTask(task);
             else
-            {
                 break;
-            }
         }
     }
+
+    void Pipeline::Routine::runTask(inner::Task *task)
+    {
+        auto *const counters = task->getCounters();
+        if(counters)
+        {
+            const auto start = inner::TaskCounters::Clock::now();
+            std::size_t runs = 1;
+            while(task->run())
+                ++runs;
+            counters->countRuns(runs,
+                inner::TaskCounters::Clock::now() - start);
+        }
+        else
+        {
+            while(task->run())
+                ;
+        }
+        scheduler->putTask(task);
+    }
+
+    void Pipeline::Routine::fail()
+    {
+        {
+            std::lock_guard<std::mutex> lock(failure->mutex);
+            if(!failure->error)
+                failure->error = std::current_exception();
+        }
+        scheduler->stop();
+    }
 }
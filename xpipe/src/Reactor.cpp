@@ -0,0 +1,827 @@
+#include "xpipe/Reactor.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_FEAT_FAST_POLL) && defined(__NR_io_uring_setup)
+#define XPIPE_IO_URING
+#endif
+#endif
+#endif
+
+namespace xpipe
+{
+    class Reactor::Impl
+    {
+    public:
+        virtual ~Impl() = default;
+
+        virtual Backend backend() const = 0;
+        virtual Request read(int fd, char *buffer, std::size_t size,
+            Handler &handler) = 0;
+        virtual Request send(int fd, const char *buffer, std::size_t size,
+            Handler &handler) = 0;
+        virtual Request send(int fd, const iovec *buffers,
+            std::size_t count, Handler &handler) = 0;
+        virtual void cancel(Request request) = 0;
+        // completes the requests until stopped or until the reactor fails,
+        // the pending ones get the error then and the next ones throw it
+        virtual void loop() = 0;
+        virtual void stop() = 0;
+    };
+
+    namespace
+    {
+        std::system_error lastError(const char *what)
+        {
+            return std::system_error(errno, std::generic_category(), what);
+        }
+
+        class Descriptor
+        {
+        public:
+            explicit Descriptor(int fd, const char *what)
+                :fd(fd)
+            {
+                if(fd < 0)
+                    throw lastError(what);
+            }
+
+            ~Descriptor()
+            {
+                ::close(fd);
+            }
+
+            Descriptor(const Descriptor&) = delete;
+            Descriptor &operator=(const Descriptor&) = delete;
+
+            int get() const
+            {
+                return fd;
+            }
+
+        private:
+            int fd;
+        };
+
+        class EpollImpl: public Reactor::Impl
+        {
+        public:
+            EpollImpl()
+                :epoll(::epoll_create1(EPOLL_CLOEXEC), "epoll_create1"),
+                wake(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK), "eventfd"),
+                mutex(), requests(), immediate(), cancelled(), lastId(0),
+                failure(0), stopping(false)
+            {
+                epoll_event event;
+                std::memset(&event, 0, sizeof(event));
+                event.events = EPOLLIN;
+                event.data.fd = wake.get();
+                if(::epoll_ctl(epoll.get(), EPOLL_CTL_ADD, wake.get(),
+                        &event) != 0)
+                    throw lastError("epoll_ctl");
+            }
+
+            Reactor::Backend backend() const override
+            {
+                return Reactor::Backend::Epoll;
+            }
+
+            Reactor::Request read(int fd, char *buffer, std::size_t size,
+                Reactor::Handler &handler) override
+            {
+                return start(fd, Request{buffer, size, nullptr, 0, &handler,
+                        0, false});
+            }
+
+            Reactor::Request send(int fd, const char *buffer,
+                std::size_t size, Reactor::Handler &handler) override
+            {
+                return start(fd, Request{const_cast<char*>(buffer), size,
+                        nullptr, 0, &handler, 0, true});
+            }
+
+            Reactor::Request send(int fd, const iovec *buffers,
+                std::size_t count, Reactor::Handler &handler) override
+            {
+                return start(fd, Request{nullptr, 0, buffers, count,
+                        &handler, 0, true});
+            }
+
+            void cancel(Reactor::Request request) override
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    cancelled.push_back(request);
+                }
+                notify();
+            }
+
+            void loop() override
+            {
+                const int maxEvents = 64;
+                epoll_event events[maxEvents];
+                while(true)
+                {
+                    const int count = ::epoll_wait(epoll.get(), events,
+                        maxEvents, -1);
+                    if(count < 0)
+                    {
+                        if(errno == EINTR)
+                            continue;
+                        fail(errno);
+                        return;
+                    }
+                    for(int i = 0; i < count; ++i)
+                    {
+                        if(events[i].data.fd == wake.get())
+                        {
+                            std::uint64_t value;
+                            while(::read(wake.get(), &value,
+                                    sizeof(value)) > 0)
+                                ;
+                        }
+                        else
+                            perform(events[i].data.fd);
+                    }
+                    if(!handleWake())
+                        return;
+                }
+            }
+
+            void stop() override
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                notify();
+            }
+
+        private:
+            struct Request
+            {
+                char *buffer;
+                std::size_t size;
+                // the buffer is sent alone without them
+                const iovec *buffers;
+                std::size_t count;
+                Reactor::Handler *handler;
+                Reactor::Request id;
+                bool sending;
+            };
+
+            using RequestMap = std::unordered_map<int, Request>;
+
+        private:
+            Reactor::Request start(int fd, Request request)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(failure != 0)
+                    {
+                        errno = failure;
+                        throw lastError("epoll_wait");
+                    }
+                    request.id = ++lastId;
+                }
+                add(fd, request);
+                return request.id;
+            }
+
+            void add(int fd, const Request &request)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    requests[fd] = request;
+                }
+                if(arm(fd, request.sending?EPOLLOUT:EPOLLIN))
+                    return;
+                const int err = errno;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    // regular files are always ready and can not be polled
+                    if(err != EPERM)
+                    {
+                        requests.erase(fd);
+                        errno = err;
+                        throw lastError("epoll_ctl");
+                    }
+                    immediate.push_back(fd);
+                }
+                notify();
+            }
+
+            bool arm(int fd, std::uint32_t events)
+            {
+                epoll_event event;
+                std::memset(&event, 0, sizeof(event));
+                event.events = events | EPOLLONESHOT;
+                event.data.fd = fd;
+                if(::epoll_ctl(epoll.get(), EPOLL_CTL_MOD, fd, &event) == 0)
+                    return true;
+                return errno == ENOENT &&
+                    ::epoll_ctl(epoll.get(), EPOLL_CTL_ADD, fd, &event) == 0;
+            }
+
+            void notify()
+            {
+                const std::uint64_t value = 1;
+                // a full counter wakes the loop all the same
+                if(::write(wake.get(), &value, sizeof(value)) < 0)
+                    assert(errno == EAGAIN);
+            }
+
+            // false once stopped
+            bool handleWake()
+            {
+                std::vector<int> fds;
+                std::vector<Reactor::Handler*> handlers;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(stopping)
+                        return false;
+                    fds.swap(immediate);
+                    // the reads over already are not found
+                    for(const auto id : cancelled)
+                    {
+                        for(auto iter = std::begin(requests);
+                            iter != std::end(requests); ++iter)
+                        {
+                            if(iter->second.id == id)
+                            {
+                                handlers.push_back(iter->second.handler);
+                                requests.erase(iter);
+                                break;
+                            }
+                        }
+                    }
+                    cancelled.clear();
+                }
+                for(auto fd : fds)
+                    perform(fd);
+                for(auto *h : handlers)
+                    h->complete(-ECANCELED);
+                return true;
+            }
+
+            void perform(int fd)
+            {
+                Request request;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto iter = requests.find(fd);
+                    // cancelled
+                    if(iter == std::end(requests))
+                        return;
+                    request = iter->second;
+                    requests.erase(iter);
+                }
+                const auto res = request.sending?sendTo(fd, request):
+                    ::read(fd, request.buffer, request.size);
+                if(res < 0 && (errno == EAGAIN || errno == EINTR))
+                {
+                    try
+                    {
+                        add(fd, request);
+                        return;
+                    }
+                    catch(const std::system_error &e)
+                    {
+                        request.handler->complete(-e.code().value());
+                        return;
+                    }
+                }
+                request.handler->complete(res < 0?-errno:res);
+            }
+
+            static ssize_t sendTo(int fd, const Request &request)
+            {
+                iovec single{request.buffer, request.size};
+                msghdr message;
+                std::memset(&message, 0, sizeof(message));
+                message.msg_iov = request.buffers?
+                    const_cast<iovec*>(request.buffers):&single;
+                message.msg_iovlen = request.buffers?request.count:1;
+                // a blocking socket is not waited on either
+                return ::sendmsg(fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+            }
+
+            void fail(int error)
+            {
+                RequestMap failed;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    failure = error;
+                    failed.swap(requests);
+                    immediate.clear();
+                    cancelled.clear();
+                }
+                for(const auto &r : failed)
+                    r.second.handler->complete(-error);
+            }
+
+        private:
+            Descriptor epoll;
+            Descriptor wake;
+            std::mutex mutex;
+            RequestMap requests;
+            std::vector<int> immediate;
+            std::vector<Reactor::Request> cancelled;
+            Reactor::Request lastId;
+            int failure;
+            bool stopping;
+        };
+
+#ifdef XPIPE_IO_URING
+        int ioUringSetup(unsigned entries, io_uring_params &params)
+        {
+            return static_cast<int>(::syscall(__NR_io_uring_setup, entries,
+                    &params));
+        }
+
+        int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete,
+            unsigned flags)
+        {
+            return static_cast<int>(::syscall(__NR_io_uring_enter, fd,
+                    toSubmit, minComplete, flags, nullptr, 0));
+        }
+
+        class Mapping
+        {
+        public:
+            Mapping(int fd, std::size_t size, off_t offset)
+                :size(size), data(::mmap(nullptr, size,
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, offset))
+            {
+                if(data == MAP_FAILED)
+                    throw lastError("mmap");
+            }
+
+            ~Mapping()
+            {
+                ::munmap(data, size);
+            }
+
+            Mapping(const Mapping&) = delete;
+            Mapping &operator=(const Mapping&) = delete;
+
+            template<typename T>
+            T *at(std::size_t offset) const
+            {
+                return reinterpret_cast<T*>(
+                    static_cast<char*>(data) + offset);
+            }
+
+        private:
+            std::size_t size;
+            void *data;
+        };
+
+        // the rings are used without liburing, the submissions are
+        // serialized and handed to the kernel one by one so the submission
+        // ring never fills up
+        class IoUringImpl: public Reactor::Impl
+        {
+        public:
+            static const unsigned ENTRIES = 256;
+
+        public:
+            explicit IoUringImpl(const io_uring_params &params, int fd)
+                :params(params), ring(fd, "io_uring_setup"),
+                sq(ring.get(), params.sq_off.array +
+                    params.sq_entries*sizeof(unsigned), IORING_OFF_SQ_RING),
+                cq(ring.get(), params.cq_off.cqes +
+                    params.cq_entries*sizeof(io_uring_cqe),
+                    IORING_OFF_CQ_RING),
+                sqes(ring.get(), params.sq_entries*sizeof(io_uring_sqe),
+                    IORING_OFF_SQES),
+                mutex(), pending(), lastId(0), failure(0), stopping(false)
+            {}
+
+            // nullptr if io_uring can not be used
+            static std::unique_ptr<Reactor::Impl> create()
+            {
+                io_uring_params params;
+                std::memset(&params, 0, sizeof(params));
+                const int fd = ioUringSetup(ENTRIES, params);
+                if(fd < 0)
+                    return nullptr;
+                // without it reads of sockets block kernel threads
+                if(!(params.features & IORING_FEAT_FAST_POLL))
+                {
+                    ::close(fd);
+                    return nullptr;
+                }
+                return std::unique_ptr<Reactor::Impl>(
+                    new IoUringImpl(params, fd));
+            }
+
+            Reactor::Backend backend() const override
+            {
+                return Reactor::Backend::IoUring;
+            }
+
+            Reactor::Request read(int fd, char *buffer, std::size_t size,
+                Reactor::Handler &handler) override
+            {
+                return start(handler, [&](io_uring_sqe &sqe, msghdr&){
+                        sqe.opcode = IORING_OP_READ;
+                        sqe.fd = fd;
+                        // the current position of the file
+                        sqe.off = static_cast<std::uint64_t>(-1);
+                        sqe.addr = reinterpret_cast<std::uintptr_t>(buffer);
+                        sqe.len = static_cast<unsigned>(size);
+                    });
+            }
+
+            Reactor::Request send(int fd, const char *buffer,
+                std::size_t size, Reactor::Handler &handler) override
+            {
+                return start(handler, [&](io_uring_sqe &sqe, msghdr&){
+                        sqe.opcode = IORING_OP_SEND;
+                        sqe.fd = fd;
+                        sqe.addr = reinterpret_cast<std::uintptr_t>(buffer);
+                        sqe.len = static_cast<unsigned>(size);
+                        sqe.msg_flags = MSG_NOSIGNAL;
+                    });
+            }
+
+            Reactor::Request send(int fd, const iovec *buffers,
+                std::size_t count, Reactor::Handler &handler) override
+            {
+                return start(handler, [&](io_uring_sqe &sqe,
+                        msghdr &message){
+                        message.msg_iov = const_cast<iovec*>(buffers);
+                        message.msg_iovlen = count;
+                        sqe.opcode = IORING_OP_SENDMSG;
+                        sqe.fd = fd;
+                        sqe.addr = reinterpret_cast<std::uintptr_t>(&message);
+                        sqe.len = 1;
+                        sqe.msg_flags = MSG_NOSIGNAL;
+                    });
+            }
+
+            void cancel(Reactor::Request request) override
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                // the cancellation of a read that is over finds nothing
+                if(failure == 0 && pending.count(request) != 0)
+                    submit([&](io_uring_sqe &sqe){
+                            sqe.opcode = IORING_OP_ASYNC_CANCEL;
+                            sqe.fd = -1;
+                            sqe.addr = request;
+                        });
+            }
+
+            void loop() override
+            {
+                auto *const head = cq.at<unsigned>(params.cq_off.head);
+                auto *const tail = cq.at<unsigned>(params.cq_off.tail);
+                const auto mask = *cq.at<unsigned>(params.cq_off.ring_mask);
+                auto *const cqes = cq.at<io_uring_cqe>(params.cq_off.cqes);
+                while(!stopping.load())
+                {
+                    if(ioUringEnter(ring.get(), 0, 1,
+                            IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+                    {
+                        fail(errno);
+                        return;
+                    }
+                    auto cur = *head;
+                    const auto end = __atomic_load_n(tail, __ATOMIC_ACQUIRE);
+                    for(; cur != end; ++cur)
+                    {
+                        const auto &cqe = cqes[cur & mask];
+                        const Reactor::Request id = cqe.user_data;
+                        const long res = cqe.res;
+                        __atomic_store_n(head, cur + 1, __ATOMIC_RELEASE);
+                        // the cancellations and the wake up have no handler
+                        Reactor::Handler *handler = nullptr;
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            auto iter = pending.find(id);
+                            if(iter != std::end(pending))
+                            {
+                                handler = iter->second.handler;
+                                pending.erase(iter);
+                            }
+                        }
+                        if(handler)
+                            handler->complete(res);
+                    }
+                }
+            }
+
+            void stop() override
+            {
+                stopping = true;
+                std::lock_guard<std::mutex> lock(mutex);
+                if(failure == 0)
+                    submit([](io_uring_sqe &sqe){
+                            sqe.opcode = IORING_OP_NOP;
+                            sqe.fd = -1;
+                        });
+            }
+
+        private:
+            struct Pending
+            {
+                Reactor::Handler *handler;
+                // of a vectored send, the elements are not moved by the map
+                msghdr message;
+            };
+
+            using PendingMap = std::unordered_map<Reactor::Request, Pending>;
+
+        private:
+            template<class F>
+            Reactor::Request start(Reactor::Handler &handler, F fill)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(failure != 0)
+                {
+                    errno = failure;
+                    throw lastError("io_uring_enter");
+                }
+                const auto id = ++lastId;
+                auto &request = pending[id];
+                request.handler = &handler;
+                std::memset(&request.message, 0, sizeof(request.message));
+                try
+                {
+                    submit([&](io_uring_sqe &sqe){
+                            fill(sqe, request.message);
+                            sqe.user_data = id;
+                        });
+                }
+                catch(...)
+                {
+                    pending.erase(id);
+                    throw;
+                }
+                return id;
+            }
+
+            // the mutex has to be locked
+            template<class F>
+            void submit(F fill)
+            {
+                auto *const tail = sq.at<unsigned>(params.sq_off.tail);
+                const auto mask = *sq.at<unsigned>(params.sq_off.ring_mask);
+                const auto cur = *tail;
+                const auto idx = cur & mask;
+                auto &sqe = sqes.at<io_uring_sqe>(0)[idx];
+                std::memset(&sqe, 0, sizeof(sqe));
+                fill(sqe);
+                sq.at<unsigned>(params.sq_off.array)[idx] = idx;
+                __atomic_store_n(tail, cur + 1, __ATOMIC_RELEASE);
+                int res;
+                while((res = ioUringEnter(ring.get(), 1, 0, 0)) < 0 &&
+                    (errno == EINTR || errno == EAGAIN || errno == EBUSY))
+                    ;
+                if(res < 0)
+                    throw lastError("io_uring_enter");
+            }
+
+            void fail(int error)
+            {
+                PendingMap failed;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    failure = error;
+                    failed.swap(pending);
+                }
+                for(const auto &p : failed)
+                    p.second.handler->complete(-error);
+            }
+
+        private:
+            io_uring_params params;
+            Descriptor ring;
+            Mapping sq;
+            Mapping cq;
+            Mapping sqes;
+            std::mutex mutex;
+            PendingMap pending;
+            Reactor::Request lastId;
+            int failure;
+            std::atomic<bool> stopping;
+        };
+#endif
+
+        std::unique_ptr<Reactor::Impl> makeImpl(Reactor::Backend backend)
+        {
+#ifdef XPIPE_IO_URING
+            if(backend != Reactor::Backend::Epoll)
+            {
+                auto res = IoUringImpl::create();
+                if(res)
+                    return res;
+            }
+#endif
+            if(backend == Reactor::Backend::IoUring)
+                throw std::runtime_error("io_uring is not supported");
+            return std::unique_ptr<Reactor::Impl>(new EpollImpl());
+        }
+    }
+
+    Reactor::Reactor(Backend backend)
+        :impl(makeImpl(backend)), thread()
+    {
+        thread = std::thread([this](){
+                impl->loop();
+            });
+    }
+
+    Reactor::~Reactor()
+    {
+        impl->stop();
+        thread.join();
+    }
+
+    Reactor::Backend Reactor::getBackend() const
+    {
+        return impl->backend();
+    }
+
+    Reactor::Request Reactor::read(int fd, char *buffer, std::size_t size,
+        Handler &handler)
+    {
+        return impl->read(fd, buffer, size, handler);
+    }
+
+    Reactor::Request Reactor::send(int fd, const char *buffer,
+        std::size_t size, Handler &handler)
+    {
+        return impl->send(fd, buffer, size, handler);
+    }
+
+    Reactor::Request Reactor::send(int fd, const iovec *buffers,
+        std::size_t count, Handler &handler)
+    {
+        return impl->send(fd, buffers, count, handler);
+    }
+
+    void Reactor::cancel(Request request)
+    {
+        impl->cancel(request);
+    }
+
+    ReadRunnable::ReadRunnable(Reactor &reactor, int fd,
+        std::size_t bufferSize, std::size_t bufferCount)
+        :reactor(reactor), fd(fd), bufferSize(bufferSize),
+        bufferCount(bufferCount), inlet(nullptr), buffer(), mutex(), cond(),
+        ready(), request(0), inFlight(false), completing(false), ended(false),
+        stopping(false), error(0)
+    {
+        if(bufferSize == 0)
+            throw std::invalid_argument("buffer size is 0");
+        if(bufferCount == 0)
+            throw std::invalid_argument("buffer count is 0");
+    }
+
+    void ReadRunnable::init(RunnableInlet<std::vector<char>> &inlet)
+    {
+        this->inlet = &inlet;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.clear();
+            ended = false;
+            stopping = false;
+            error = 0;
+            inFlight = true;
+        }
+        submit();
+    }
+
+    void ReadRunnable::destroy()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+        // a completion may be about to submit the next read
+        cond.wait(lock, [this](){
+                return !completing;
+            });
+        if(inFlight)
+        {
+            const auto last = request;
+            lock.unlock();
+            reactor.cancel(last);
+            lock.lock();
+            cond.wait(lock, [this](){
+                    return !inFlight && !completing;
+                });
+        }
+        inlet = nullptr;
+    }
+
+    bool ReadRunnable::canRun()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !ready.empty() || ended;
+    }
+
+    bool ReadRunnable::run()
+    {
+        assert(inlet);
+        std::vector<char> value;
+        bool next = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(ready.empty())
+            {
+                if(error != 0)
+                    throw std::system_error(error, std::generic_category(),
+                        "read failed");
+                return !ended;
+            }
+            value = std::move(ready.front());
+            ready.pop_front();
+            next = !inFlight && !ended && !stopping;
+            if(next)
+                inFlight = true;
+        }
+        if(next)
+            submit();
+        inlet->push(std::move(value));
+        return true;
+    }
+
+    void ReadRunnable::complete(long result)
+    {
+        bool next = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlight = false;
+            if(result > 0)
+            {
+                buffer.resize(static_cast<std::size_t>(result));
+                ready.push_back(std::move(buffer));
+                buffer = std::vector<char>();
+            }
+            else if(result == 0 && !stopping)
+            {
+                ready.emplace_back();
+                ended = true;
+            }
+            else if(result == 0 || stopping)
+                ended = true;
+            else if(result != -EINTR && result != -EAGAIN)
+            {
+                error = static_cast<int>(-result);
+                ended = true;
+            }
+            next = !ended && !stopping && ready.size() < bufferCount;
+            inFlight = next;
+            completing = true;
+        }
+        if(next)
+            submit();
+        inlet->notifyCanRun();
+        std::lock_guard<std::mutex> lock(mutex);
+        completing = false;
+        // destroy may return and the runnable be gone once the lock is
+        // released
+        cond.notify_all();
+    }
+
+    void ReadRunnable::submit()
+    {
+        buffer.resize(bufferSize);
+        try
+        {
+            const auto id = reactor.read(fd, buffer.data(), buffer.size(),
+                *this);
+            std::lock_guard<std::mutex> lock(mutex);
+            // the read may have completed and the next one started already
+            request = std::max(request, id);
+        }
+        catch(const std::system_error &e)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlight = false;
+            error = e.code().value();
+            ended = true;
+        }
+    }
+}
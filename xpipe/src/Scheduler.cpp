@@ -5,8 +5,10 @@
 #include <queue>
 #include <cassert>
 #include <unordered_set>
-#include <limits>
 #include <iterator>
+#include <algorithm>
+#include <string>
+#include <thread>
 
 namespace xpipe
 {
@@ -15,6 +17,33 @@ namespace xpipe
         using NodeSet = std::unordered_set<inner::Node*>;
         using NodeQueue = std::queue<inner::Node*>;
 
+        struct WorkerContext
+        {
+            const Scheduler *scheduler;
+            std::size_t worker;
+        };
+
+        thread_local WorkerContext currentWorker = {nullptr, 0};
+
+        // the spins of SpinPark double when the work comes while spinning
+        // and halve when it does not
+        const std::size_t INITIAL_SPINS = 256;
+        const std::size_t MIN_SPINS = 16;
+        const std::size_t MAX_SPINS = 8192;
+        // before SpinYield starts to yield
+        const std::size_t YIELD_AFTER_SPINS = 256;
+
+        // tells the cpu it is in a spin loop so the loop is not a burden
+        // on the other hardware thread of the core
+        inline void cpuRelax()
+        {
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__) && defined(__GNUC__)
+            __asm__ __volatile__("yield");
+#endif
+        }
+
         NodeSet findRoots(inner::Node &node)
         {
             NodeSet roots;
@@ -56,11 +85,67 @@ namespace xpipe
         }
     }
 
-    Scheduler::Scheduler(inner::graphptr::NodePointer<inner::Node> node)
-        :node(node), mutex(), cond(),
-        ready(), waiting(),
-        childDeps(), parentDeps(), priorities(), tasks()
+    Scheduler::Scheduler(inner::graphptr::NodePointer<inner::Node> node,
+        std::size_t workerCount, SchedulingMode mode, bool tracing,
+        const WorkerLayout &layout, WaitStrategy waiting)
+        :node(node), workerCount(workerCount), cont(true),
+        ready(), readyCount(0), nodeReady(), groupReady(), workerQueues(),
+        sharedCount(workerCount), nextQueue(0), idleMutex(), idleCond(),
+        sleepers(0), parked(), parkedCount(0), resume(),
+        unfinishedCount(0), waiting(waiting),
+        spinBudgets(workerCount, INITIAL_SPINS), tasks(), states(),
+        taskQueues(), childDeps(), parentDeps(), tracer(), takenAt()
     {
+        if(workerCount == 0)
+            throw std::invalid_argument("worker count is 0");
+        if((!layout.nodes.empty() && layout.nodes.size() != workerCount) ||
+            (!layout.groups.empty() && layout.groups.size() != workerCount))
+            throw std::invalid_argument("worker layout does not match workers");
+        if(!layout.groups.empty())
+        {
+            sharedCount = std::find_if(std::begin(layout.groups),
+                std::end(layout.groups), [](std::size_t g){return g != 0;}) -
+                std::begin(layout.groups);
+            if(sharedCount == 0)
+                throw std::invalid_argument("no shared workers");
+        }
+        if(!layout.nodes.empty() || sharedCount < workerCount)
+            workerQueues.resize(workerCount);
+        for(std::size_t w = 0; w < workerCount; ++w)
+        {
+            auto &queues = w < sharedCount?nodeReady:groupReady;
+            int key = -1;
+            if(w >= sharedCount)
+            {
+                if(layout.groups[w] == 0)
+                    throw std::invalid_argument(
+                        "shared workers do not go first");
+                key = static_cast<int>(layout.groups[w]);
+            }
+            else if(!layout.nodes.empty())
+            {
+                key = layout.nodes[w];
+                if(key < 0)
+                    throw std::invalid_argument("worker node is negative");
+            }
+            if(key < 0)
+                continue;
+            const auto idx = static_cast<std::size_t>(key);
+            if(idx >= queues.size())
+                queues.resize(idx + 1);
+            if(!queues[idx])
+                queues[idx].reset(new RestrictedQueue(w < sharedCount));
+            workerQueues[w] = queues[idx].get();
+        }
+        if(tracing)
+        {
+            tracer.reset(new Tracer(workerCount));
+            takenAt.resize(workerCount);
+        }
+        const std::size_t queueCount =
+            mode == SchedulingMode::WorkStealing?sharedCount:1;
+        for(std::size_t i = 0; i < queueCount; ++i)
+            ready.emplace_back(new ReadyQueue());
         auto roots = findRoots(*node);
         using CandQueue = std::queue<inner::Node*>;
         CandQueue front;
@@ -70,7 +155,9 @@ namespace xpipe
             front.push(n);
             seenNodes.insert(n);
         }
-        std::size_t priority = std::numeric_limits<std::size_t>::max();
+        // indices follow the breadth-first order from the roots, it is
+        // the priority order of the tasks as well
+        std::vector<inner::Node*> taskNodes;
         while(!front.empty())
         {
             auto *cur = front.front();
@@ -79,21 +166,10 @@ namespace xpipe
             auto *const curTask = cur->task();
             if(curTask)
             {
-                tasks.insert(curTask);
-                const auto r = priorities.insert(
-                    std::make_pair(curTask, priority--)).second;
-                (void)r;
-                assert(r);
-                unfinishedTasks.insert(curTask);
-                waiting.insert(curTask);
-                const auto childDepInsertRes = childDeps.insert(
-                    std::make_pair(curTask, findChildTasks(*cur))).second;
-                (void)childDepInsertRes;
-                assert(childDepInsertRes);
-                const auto parentDepInsertRes = parentDeps.insert(
-                    std::make_pair(curTask, findParentTasks(*cur))).second;
-                (void)parentDepInsertRes;
-                assert(parentDepInsertRes);
+                curTask->setIndex(tasks.size());
+                tasks.push_back(curTask);
+                taskQueues.push_back(restrictedQueue(*curTask, layout));
+                taskNodes.push_back(cur);
                 curTask->setListener(this);
             }
             const auto &children = cur->children();
@@ -106,6 +182,10 @@ namespace xpipe
                 }
             }
         }
+        states.reset(new TaskState[tasks.size()]);
+        unfinishedCount = tasks.size();
+        childDeps = makeAdjacency(taskNodes, &Scheduler::findChildTasks);
+        parentDeps = makeAdjacency(taskNodes, &Scheduler::findParentTasks);
     }
 
     Scheduler::~Scheduler()
@@ -119,163 +199,444 @@ namespace xpipe
 
     void Scheduler::start()
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        for(auto iter = begin(waiting); iter != end(waiting);)
-        {
-            if((*iter)->canRun())
-            {
-                auto *readyTask = *iter;
-                waiting.erase(iter++);
-                markReady(lock, *readyTask);
-            }
-            else
-            {
-                ++iter;
-            }
-        }
+        for(std::size_t idx = 0; idx < tasks.size(); ++idx)
+            updateReadiness(idx);
     }
 
     void Scheduler::stop()
     {
-        std::lock_guard<std::mutex> lock(mutex);
         cont = false;
-        cond.notify_all();
+        wakeAllWorkers();
     }
 
-    inner::Task *Scheduler::takeTask()
+    inner::Task *Scheduler::takeTask(std::size_t worker)
     {
-        std::unique_lock<std::mutex> lock(mutex);
+        assert(worker < workerCount);
+        const bool shared = worker < sharedCount;
+        auto *const own = workerQueues.empty()?nullptr:workerQueues[worker];
+        currentWorker = WorkerContext{this, worker};
         while(true)
         {
-            if(cont)
+            if(!cont)
+                break;
+            inner::Task *task = popFor(worker);
+            if(task == nullptr && waiting != WaitStrategy::Blocking)
             {
-                if(ready.empty())
-                {
-                    if(unfinishedTasks.empty())
-                        return nullptr;
-                    cond.wait(lock, [this](){
-                            return !cont || !ready.empty() ||
-                                unfinishedTasks.empty();
-                        });
-                }
-                else
-                {
-                    const auto task = ready.top();
-                    ready.pop();
-                    return task.task;
-                }
+                const auto spinStart = tracer?Tracer::Clock::now():
+                    Tracer::Clock::time_point();
+                const bool woken = spin(worker, shared, own);
+                if(tracer)
+                    tracer->slice(worker, "idle", "spin", spinStart,
+                        Tracer::Clock::now());
+                // the end of the run is seen below
+                if(woken && unfinishedCount > 0)
+                    continue;
             }
-            else
+            if(task != nullptr)
             {
-                return nullptr;
+                auto *const counters = task->getCounters();
+                if(counters)
+                    counters->markTaken(inner::TaskCounters::Clock::now());
+                if(tracer)
+                    takenAt[worker] = Tracer::Clock::now();
+                return task;
             }
+            std::unique_lock<std::mutex> lock(idleMutex);
+            if(unfinishedCount == 0)
+                break;
+            auto &sleeping = shared?sleepers:own->sleepers;
+            ++sleeping;
+            const auto idleStart = tracer?Tracer::Clock::now():
+                Tracer::Clock::time_point();
+            (shared?idleCond:own->cond).wait(lock, [this, shared, own](){
+                    return mayTake(shared, own);
+                });
+            if(tracer)
+                tracer->slice(worker, "idle", "idle", idleStart,
+                    Tracer::Clock::now());
+            --sleeping;
+        }
+        // the thread may go on to work for other schedulers
+        currentWorker = WorkerContext{nullptr, 0};
+        return nullptr;
+    }
+
+    inner::Task *Scheduler::tryTakeTask(std::size_t worker)
+    {
+        assert(worker < workerCount);
+        inner::Task *task = nullptr;
+        if(cont)
+            task = popFor(worker);
+        if(task == nullptr)
+        {
+            currentWorker = WorkerContext{nullptr, 0};
+            return nullptr;
         }
+        currentWorker = WorkerContext{this, worker};
+        auto *const counters = task->getCounters();
+        if(counters)
+            counters->markTaken(inner::TaskCounters::Clock::now());
+        if(tracer)
+            takenAt[worker] = Tracer::Clock::now();
+        return task;
     }
 
     void Scheduler::putTask(inner::Task *task)
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        if(unfinishedTasks.find(task) != std::end(unfinishedTasks))
+        assert(task);
+        if(tracer && currentWorker.scheduler == this)
         {
-            if(task->canRun())
-            {
-                markReady(lock, *task);
-                cond.notify_one();
-            }
-            else
-            {
-                waiting.insert(task);
-            }
+            const auto worker = currentWorker.worker;
+            tracer->slice(worker, "run", taskLabel(*task), takenAt[worker],
+                Tracer::Clock::now());
         }
+        const auto idx = indexOf(*task);
+        auto &state = states[idx];
+        assert(state.status == TaskStatus::Queued);
+        state.status = TaskStatus::Checking;
+        if(!checkReadiness(idx) && !state.finished)
+            trace("wait", *task);
+    }
+
+    bool Scheduler::isOver() const
+    {
+        return !cont || unfinishedCount == 0;
+    }
+
+    bool Scheduler::park(std::size_t worker)
+    {
+        assert(worker < sharedCount);
+        assert(resume);
+        auto *const own = workerQueues.empty()?nullptr:workerQueues[worker];
+        std::lock_guard<std::mutex> lock(idleMutex);
+        parked.push_back(worker);
+        // pairs with the count of the ready tasks before the wake up
+        ++parkedCount;
+        if(!mayTake(true, own))
+            return true;
+        parked.pop_back();
+        --parkedCount;
+        return false;
+    }
+
+    void Scheduler::setResume(Resume resume)
+    {
+        this->resume = std::move(resume);
+    }
+
+    void Scheduler::writeTrace(std::ostream &stream)
+    {
+        if(tracer)
+            tracer->write(stream);
     }
 
     void Scheduler::notifyPush(inner::Task &inst)
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        updateChildrenReadiness(lock, inst);
+        trace("push", inst);
+        updateReadiness(childDeps, indexOf(inst));
     }
 
     void Scheduler::notifyPull(inner::Task &inst)
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        updateReadiness(lock, inst);
+        trace("pull", inst);
+        const auto idx = indexOf(inst);
+        if(!states[idx].finished)
+            updateReadiness(idx);
+        else
+            updateReadiness(childDeps, idx);
     }
 
     void Scheduler::notifySelf(inner::Task &inst)
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        updateReadiness(lock, inst);
+        trace("self", inst);
+        updateReadiness(indexOf(inst));
     }
 
     void Scheduler::notifyFinished(inner::Task &inst)
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        markFinished(lock, inst);
-        if(unfinishedTasks.empty())
+        trace("finished", inst);
+        markFinished(indexOf(inst));
+    }
+
+    void Scheduler::updateReadiness(std::size_t idx)
+    {
+        auto &state = states[idx];
+        state.pending = true;
+        auto expected = TaskStatus::Waiting;
+        if(state.status.compare_exchange_strong(expected,
+                TaskStatus::Checking))
+            checkReadiness(idx);
+    }
+
+    void Scheduler::updateReadiness(const TaskAdjacency &deps,
+        std::size_t idx)
+    {
+        const auto last = deps.offsets[idx + 1];
+        for(auto i = deps.offsets[idx]; i < last; ++i)
+            updateReadiness(deps.targets[i]);
+    }
+
+    bool Scheduler::checkReadiness(std::size_t idx)
+    {
+        auto &state = states[idx];
+        while(true)
         {
-            cond.notify_all();
+            state.pending = false;
+            // pairs with the fence of the queues after their update
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(state.finished)
+            {
+                state.status = TaskStatus::Finished;
+                return false;
+            }
+            if(tasks[idx]->canRun())
+            {
+                state.status = TaskStatus::Queued;
+                markReady(idx);
+                return true;
+            }
+            state.status = TaskStatus::Waiting;
+            if(!state.pending)
+                return false;
+            auto expected = TaskStatus::Waiting;
+            if(!state.status.compare_exchange_strong(expected,
+                    TaskStatus::Checking))
+                return false;
         }
     }
 
-    void Scheduler::updateReadiness(std::lock_guard<std::mutex> &lock,
-        inner::Task &task)
+    void Scheduler::markReady(std::size_t idx)
     {
-        auto iter = waiting.find(&task);
-        if(iter != end(waiting))
+        auto *const task = tasks[idx];
+        auto *const counters = task->getCounters();
+        if(counters)
+            counters->markReady(inner::TaskCounters::Clock::now());
+        if(auto *const restricted = taskQueues[idx])
         {
-            if(unfinishedTasks.find(&task) != std::end(unfinishedTasks) &&
-                task.canRun())
             {
-                waiting.erase(iter);
-                markReady(lock, task);
-                cond.notify_one();
+                std::lock_guard<std::mutex> queueLock(
+                    restricted->queue.mutex);
+                restricted->queue.tasks.push(PrioritizedTask{task, idx});
             }
+            ++restricted->count;
+            wakeWorker(*restricted);
+            return;
         }
+        auto &queue = *ready[localQueue()];
+        {
+            std::lock_guard<std::mutex> queueLock(queue.mutex);
+            queue.tasks.push(PrioritizedTask{task, idx});
+        }
+        ++readyCount;
+        wakeWorker();
+    }
+
+    void Scheduler::markFinished(std::size_t idx)
+    {
+        if(!states[idx].finished.exchange(true))
+        {
+            updateReadiness(parentDeps, idx);
+            updateReadiness(childDeps, idx);
+            if(--unfinishedCount == 0)
+                wakeAllWorkers();
+        }
+    }
+
+    bool Scheduler::mayTake(bool shared, const RestrictedQueue *own) const
+    {
+        return !cont || (shared && readyCount > 0) ||
+            (own && own->count > 0) || unfinishedCount == 0;
     }
 
-    void Scheduler::updateChildrenReadiness(std::lock_guard<std::mutex> &lock,
-        inner::Task &task)
+    bool Scheduler::spin(std::size_t worker, bool shared,
+        const RestrictedQueue *own)
     {
-        auto depIters = childDeps.find(&task);
-        if(depIters != std::end(childDeps))
+        switch(waiting)
+        {
+        case WaitStrategy::Blocking:
+            return false;
+        case WaitStrategy::BusySpin:
+            while(!mayTake(shared, own))
+                cpuRelax();
+            return true;
+        case WaitStrategy::SpinYield:
+            for(std::size_t i = 0; !mayTake(shared, own); ++i)
+            {
+                if(i < YIELD_AFTER_SPINS)
+                    cpuRelax();
+                else
+                    std::this_thread::yield();
+            }
+            return true;
+        case WaitStrategy::SpinPark:
+            break;
+        }
+        auto &budget = spinBudgets[worker];
+        for(std::size_t i = 0; i < budget; ++i)
         {
-            for(auto *depTask : depIters->second)
+            if(mayTake(shared, own))
             {
-                assert(depTask);
-                updateReadiness(lock, *depTask);
+                budget = std::min(budget*2, MAX_SPINS);
+                return true;
             }
+            cpuRelax();
         }
+        budget = std::max(budget/2, MIN_SPINS);
+        return false;
+    }
+
+    std::size_t Scheduler::indexOf(const inner::Task &task) const
+    {
+        const auto idx = task.getIndex();
+        if(idx >= tasks.size() || tasks[idx] != &task)
+            throw std::runtime_error("task is not scheduled");
+        return idx;
+    }
+
+    std::size_t Scheduler::localQueue()
+    {
+        if(ready.size() == 1)
+            return 0;
+        // tasks readied by a worker stay on its queue to reuse warm caches,
+        // the rest are spread over the workers
+        if(currentWorker.scheduler == this)
+            return currentWorker.worker%ready.size();
+        return nextQueue.fetch_add(1)%ready.size();
+    }
+
+    void Scheduler::trace(const char *event, inner::Task &task)
+    {
+        if(!tracer)
+            return;
+        tracer->instant(
+            currentWorker.scheduler == this?currentWorker.worker:workerCount,
+            event, std::string(event) + " " + taskLabel(task));
+    }
+
+    std::string Scheduler::taskLabel(inner::Task &task) const
+    {
+        if(!task.getName().empty())
+            return task.getName();
+        return "task " + std::to_string(task.getIndex());
+    }
+
+    inner::Task *Scheduler::popReady(ReadyQueue &queue,
+        std::atomic<std::size_t> &count)
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty())
+            return nullptr;
+        auto *const task = queue.tasks.top().task;
+        queue.tasks.pop();
+        --count;
+        return task;
     }
 
-    void Scheduler::updateParentsReadiness(std::lock_guard<std::mutex> &lock,
-        inner::Task &task)
+    inner::Task *Scheduler::stealReady(std::size_t worker)
     {
-        auto depIters = parentDeps.find(&task);
-        if(depIters != std::end(parentDeps))
+        const auto sz = ready.size();
+        for(std::size_t i = 1; i < sz && readyCount > 0; ++i)
         {
-            for(auto *depTask : depIters->second)
+            auto *const task = popReady(*ready[(worker + i)%sz],
+                readyCount);
+            if(task != nullptr)
+                return task;
+        }
+        return nullptr;
+    }
+
+    inner::Task *Scheduler::popFor(std::size_t worker)
+    {
+        auto *const own = workerQueues.empty()?nullptr:workerQueues[worker];
+        inner::Task *task = nullptr;
+        if(own)
+            task = popReady(own->queue, own->count);
+        if(task == nullptr && worker < sharedCount)
+        {
+            const auto queueIdx = worker%ready.size();
+            task = popReady(*ready[queueIdx], readyCount);
+            if(task == nullptr)
+                task = stealReady(queueIdx);
+        }
+        return task;
+    }
+
+    void Scheduler::resumeParked(bool all)
+    {
+        if(parkedCount == 0)
+            return;
+        std::vector<std::size_t> workers;
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            const auto count = all?parked.size():
+                std::min<std::size_t>(1, parked.size());
+            workers.assign(parked.end() - count, parked.end());
+            parked.resize(parked.size() - count);
+            parkedCount -= count;
+        }
+        // the worker may take its task before the resume returns
+        for(const auto worker : workers)
+            resume(worker);
+    }
+
+    void Scheduler::wakeWorker()
+    {
+        if(sleepers > 0)
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            idleCond.notify_one();
+        }
+        resumeParked(false);
+    }
+
+    void Scheduler::wakeWorker(RestrictedQueue &queue)
+    {
+        if(queue.shared)
+        {
+            // the one woken up may be on another node
+            if(sleepers > 0)
             {
-                assert(depTask);
-                updateReadiness(lock, *depTask);
+                std::lock_guard<std::mutex> lock(idleMutex);
+                idleCond.notify_all();
             }
+            resumeParked(true);
+        }
+        else if(queue.sleepers > 0)
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            queue.cond.notify_one();
         }
     }
 
-    void Scheduler::markReady(std::lock_guard<std::mutex>&, inner::Task &task)
+    void Scheduler::wakeAllWorkers()
     {
-        auto priorityIter = priorities.find(&task);
-        if(priorityIter == end(priorities))
-            throw std::runtime_error("");
-        ready.push(PrioritizedTask{&task, priorityIter->second});
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            idleCond.notify_all();
+            for(auto &queue : groupReady)
+            {
+                if(queue)
+                    queue->cond.notify_all();
+            }
+        }
+        resumeParked(true);
     }
 
-    void Scheduler::markFinished(std::lock_guard<std::mutex> &lock, inner::Task &task)
+    Scheduler::RestrictedQueue *Scheduler::restrictedQueue(
+        const inner::Task &task, const WorkerLayout &layout) const
     {
-        if(unfinishedTasks.erase(&task) > 0)
+        const auto group = layout.taskGroups.find(&task);
+        if(group != std::end(layout.taskGroups))
         {
-            updateParentsReadiness(lock, task);
-            updateChildrenReadiness(lock, task);
+            if(group->second >= groupReady.size() ||
+                !groupReady[group->second])
+                throw std::invalid_argument("thread group has no workers");
+            return groupReady[group->second].get();
         }
+        const auto node = task.getNode();
+        if(node >= 0 && static_cast<std::size_t>(node) < nodeReady.size())
+            return nodeReady[static_cast<std::size_t>(node)].get();
+        return nullptr;
     }
 
     template<typename Expand>
@@ -314,4 +675,27 @@ namespace xpipe
     {
         return findTasks(node, [](inner::Node &n){return n.children();});
     }
+
+    Scheduler::TaskAdjacency Scheduler::makeAdjacency(
+        const std::vector<inner::Node*> &taskNodes,
+        TaskSet (*find)(inner::Node&)) const
+    {
+        TaskAdjacency result;
+        result.offsets.reserve(taskNodes.size() + 1);
+        result.offsets.push_back(0);
+        for(auto *n : taskNodes)
+        {
+            assert(n);
+            for(auto *task : find(*n))
+            {
+                assert(task);
+                // tasks out of reach from the roots are never scheduled
+                const auto idx = task->getIndex();
+                if(idx < tasks.size() && tasks[idx] == task)
+                    result.targets.push_back(idx);
+            }
+            result.offsets.push_back(result.targets.size());
+        }
+        return result;
+    }
 }
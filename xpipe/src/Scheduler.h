@@ -1,32 +1,69 @@
 #ifndef XPIPE_SCHEDULER_H
 #define XPIPE_SCHEDULER_H
 
+#include <atomic>
 #include <memory>
-#include <unordered_set>
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
 #include <condition_variable>
 #include <cstddef>
+#include <functional>
 #include <queue>
 #include <vector>
+#include <ostream>
+#include <string>
 
+#include "xpipe/PipelineOptions.h"
 #include "xpipe/inner/Node.h"
 #include "xpipe/inner/Task.h"
 #include "xpipe/inner/graphptr.h"
+#include "Tracer.h"
 
 namespace xpipe
 {
     class Scheduler: public inner::Task::Listener
     {
     public:
-        Scheduler(inner::graphptr::NodePointer<inner::Node> node);
+        // which workers run which tasks
+        struct WorkerLayout
+        {
+            // indexed by the worker, empty unless they are pinned, the
+            // tasks placed on a node with workers are run only by them
+            std::vector<int> nodes;
+            // indexed by the worker, 0 for the shared workers which go
+            // first, the others run only the tasks of their group, empty
+            // for no groups
+            std::vector<std::size_t> groups;
+            std::unordered_map<const inner::Task*, std::size_t> taskGroups;
+        };
+
+        // runs a parked worker again
+        using Resume = std::function<void(std::size_t)>;
+
+    public:
+        Scheduler(inner::graphptr::NodePointer<inner::Node> node,
+            std::size_t workerCount, SchedulingMode mode,
+            bool tracing = false, const WorkerLayout &layout = WorkerLayout(),
+            WaitStrategy waiting = WaitStrategy::Blocking);
         ~Scheduler() override;
 
         void start();
         void stop();
 
-        inner::Task *takeTask();
+        inner::Task *takeTask(std::size_t worker);
+        // does not wait, null if nothing is ready or the run is over
+        inner::Task *tryTakeTask(std::size_t worker);
         void putTask(inner::Task *task);
+        bool isOver() const;
+        // a shared worker with nothing to take stops until it is resumed
+        // once a task is ready or the run is over, false if it has to take
+        // again instead, the resume is set before the start
+        bool park(std::size_t worker);
+        void setResume(Resume resume);
+
+        // the run must be over
+        void writeTrace(std::ostream &stream);
 
     protected:
         void notifyPush(inner::Task &inst) override;
@@ -38,51 +75,151 @@ namespace xpipe
         struct PrioritizedTask
         {
             inner::Task *task;
-            std::size_t priority;
+            std::size_t index;
         };
+        // tasks closer to the roots go first
         struct PrioritizedTaskLess
         {
             bool operator()(const PrioritizedTask &left,
                 const PrioritizedTask &right) const
             {
-                return left.priority < right.priority;
+                return left.index > right.index;
             }
         };
 
         using TaskSet = std::unordered_set<inner::Task*>;
         using NodeSet = std::unordered_set<inner::Node*>;
-        using TaskPriorityMap = std::unordered_map<inner::Task*, std::size_t>;
+        using TaskCol = std::vector<inner::Task*>;
         using TaskQueue = std::priority_queue<PrioritizedTask,
               std::vector<PrioritizedTask>, PrioritizedTaskLess>;
-        using TaskDepMap = std::unordered_map<inner::Task*, TaskSet>;
+
+        // a task is checked only by the thread that moved it from Waiting
+        // to Checking, a notification that loses the race leaves the
+        // pending flag for that thread to pick up
+        enum class TaskStatus
+        {
+            Waiting,
+            Checking,
+            // in a ready queue or running
+            Queued,
+            Finished
+        };
+
+        struct TaskState
+        {
+            std::atomic<TaskStatus> status{TaskStatus::Waiting};
+            std::atomic<bool> pending{false};
+            std::atomic<bool> finished{false};
+        };
+
+        // adjacency of the task indices, the neighbours of task i are
+        // targets[offsets[i]] to targets[offsets[i+1]]
+        struct TaskAdjacency
+        {
+            std::vector<std::size_t> offsets;
+            std::vector<std::size_t> targets;
+        };
+
+        struct ReadyQueue
+        {
+            std::mutex mutex;
+            TaskQueue tasks;
+        };
+        using ReadyQueueCol = std::vector<std::unique_ptr<ReadyQueue>>;
+
+        // tasks only some workers run, those of a node or of a group
+        struct RestrictedQueue
+        {
+            explicit RestrictedQueue(bool shared)
+                :shared(shared)
+            {}
+
+            ReadyQueue queue;
+            std::atomic<std::size_t> count{0};
+            // the workers of a node are shared ones and wait with them,
+            // those of a group wait for their tasks only
+            const bool shared;
+            std::condition_variable cond;
+            std::atomic<std::size_t> sleepers{0};
+        };
+        // null for the nodes without workers
+        using RestrictedQueueCol =
+            std::vector<std::unique_ptr<RestrictedQueue>>;
 
     private:
-        void updateReadiness(std::lock_guard<std::mutex> &lock,
-            inner::Task &task);
-        void updateChildrenReadiness(std::lock_guard<std::mutex> &lock,
-            inner::Task &task);
-        void updateParentsReadiness(std::lock_guard<std::mutex> &lock,
-            inner::Task &task);
-        void markReady(std::lock_guard<std::mutex>&, inner::Task &task);
-        void markFinished(std::lock_guard<std::mutex>&, inner::Task &task);
+        void updateReadiness(std::size_t idx);
+        void updateReadiness(const TaskAdjacency &deps, std::size_t idx);
+        // returns whether the task was queued
+        bool checkReadiness(std::size_t idx);
+        void markReady(std::size_t idx);
+        void markFinished(std::size_t idx);
+        // whether the worker has to look at the queues again
+        bool mayTake(bool shared, const RestrictedQueue *own) const;
+        // true once the worker may take something, false if it has to
+        // sleep
+        bool spin(std::size_t worker, bool shared,
+            const RestrictedQueue *own);
+
+        std::size_t indexOf(const inner::Task &task) const;
+        RestrictedQueue *restrictedQueue(const inner::Task &task,
+            const WorkerLayout &layout) const;
+        std::size_t localQueue();
+        void trace(const char *event, inner::Task &task);
+        std::string taskLabel(inner::Task &task) const;
+        inner::Task *popReady(ReadyQueue &queue,
+            std::atomic<std::size_t> &count);
+        inner::Task *stealReady(std::size_t worker);
+        // the tasks only the worker can run go first
+        inner::Task *popFor(std::size_t worker);
+        void resumeParked(bool all);
+        void wakeWorker();
+        void wakeWorker(RestrictedQueue &queue);
+        void wakeAllWorkers();
 
         template<typename Expand>
         static TaskSet findTasks(inner::Node &node, Expand expand);
         static TaskSet findParentTasks(inner::Node &node);
         static TaskSet findChildTasks(inner::Node &node);
+        TaskAdjacency makeAdjacency(
+            const std::vector<inner::Node*> &taskNodes,
+            TaskSet (*find)(inner::Node&)) const;
 
     private:
         inner::graphptr::NodePointer<inner::Node> node;
-        std::mutex mutex;
-        std::condition_variable cond;
-        bool cont = true;
-        TaskQueue ready;
-        TaskSet waiting;
-        TaskSet unfinishedTasks;
-        TaskDepMap childDeps;
-        TaskDepMap parentDeps;
-        TaskPriorityMap priorities;
-        TaskSet tasks;
+        const std::size_t workerCount;
+        std::atomic<bool> cont;
+        ReadyQueueCol ready;
+        // of the shared queues only
+        std::atomic<std::size_t> readyCount;
+        // indexed by the node
+        RestrictedQueueCol nodeReady;
+        // indexed by the group
+        RestrictedQueueCol groupReady;
+        // the queue besides the shared ones of each worker or null
+        std::vector<RestrictedQueue*> workerQueues;
+        std::size_t sharedCount;
+        std::atomic<std::size_t> nextQueue;
+        std::mutex idleMutex;
+        std::condition_variable idleCond;
+        std::atomic<std::size_t> sleepers;
+        // guarded by idleMutex
+        std::vector<std::size_t> parked;
+        std::atomic<std::size_t> parkedCount;
+        Resume resume;
+        std::atomic<std::size_t> unfinishedCount;
+        const WaitStrategy waiting;
+        // indexed by the worker, adapted by SpinPark
+        std::vector<std::size_t> spinBudgets;
+        // indexed by the task index
+        TaskCol tasks;
+        std::unique_ptr<TaskState[]> states;
+        // the restricted queue of each task or null
+        std::vector<RestrictedQueue*> taskQueues;
+        TaskAdjacency childDeps;
+        TaskAdjacency parentDeps;
+        std::unique_ptr<Tracer> tracer;
+        // when the task run by each worker was taken, for the trace
+        std::vector<Tracer::Clock::time_point> takenAt;
     };
 }
 
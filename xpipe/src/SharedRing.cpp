@@ -0,0 +1,355 @@
+#include "xpipe/stage/SharedRing.h"
+
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <ctime>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace xpipe
+{
+    namespace stage
+    {
+        static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+            "the ring needs lock free atomics to be shared by processes");
+
+        // the positions only grow, the one of the other side is cached and
+        // reread when the ring looks full or empty, a side waits on the
+        // futex the other one changes when it sees the waiting flag and
+        // checks now and then that the process of the other one is there
+        struct SharedRing::Layout
+        {
+            std::uint64_t magic;
+            std::uint64_t slotCount;
+            std::uint64_t slotSize;
+            std::uint64_t stride;
+            alignas(64) std::atomic<std::uint64_t> head;
+            alignas(64) std::atomic<std::uint64_t> tail;
+            alignas(64) std::atomic<std::uint32_t> headSignal;
+            std::atomic<std::uint32_t> tailSignal;
+            std::atomic<std::uint32_t> writerWaiting;
+            std::atomic<std::uint32_t> readerWaiting;
+            std::atomic<std::uint32_t> writerClosed;
+            std::atomic<std::uint32_t> readerClosed;
+            // 0 until the side is opened
+            std::atomic<std::int32_t> writerPid;
+            std::atomic<std::int32_t> readerPid;
+        };
+
+        namespace
+        {
+            const std::uint64_t MAGIC = 0x78706970656d7232;
+            const std::size_t SLOT_HEADER = sizeof(std::uint64_t);
+            const std::size_t LINE = 64;
+
+            std::size_t roundUp(std::size_t value, std::size_t to)
+            {
+                return (value + to - 1)/to*to;
+            }
+
+            std::system_error lastError(const std::string &what)
+            {
+                return std::system_error(errno, std::generic_category(),
+                    what);
+            }
+
+            // how often a waiting side checks the other one
+            const timespec CHECK_PERIOD{0, 100*1000*1000};
+
+            void futexWait(std::atomic<std::uint32_t> &word,
+                std::uint32_t expected)
+            {
+                ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+                    FUTEX_WAIT, expected, &CHECK_PERIOD, nullptr, 0);
+            }
+
+            // a process that has ended but is not reaped yet or a reused
+            // pid pass for the side
+            bool alive(const std::atomic<std::int32_t> &pid)
+            {
+                const auto value = pid.load();
+                return value == 0 || ::kill(value, 0) == 0 || errno != ESRCH;
+            }
+
+            void signal(std::atomic<std::uint32_t> &word)
+            {
+                ++word;
+                ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word),
+                    FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+            }
+
+            class SharedMemory
+            {
+            public:
+                SharedMemory(const std::string &name, int flags)
+                    :fd(::shm_open(name.c_str(), flags | O_CLOEXEC, 0600))
+                {
+                    if(fd < 0)
+                        throw lastError("failed to open " + name);
+                }
+
+                ~SharedMemory()
+                {
+                    ::close(fd);
+                }
+
+                SharedMemory(const SharedMemory&) = delete;
+                SharedMemory &operator=(const SharedMemory&) = delete;
+
+                void *map(std::size_t size) const
+                {
+                    void *const res = ::mmap(nullptr, size,
+                        PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    if(res == MAP_FAILED)
+                        throw lastError("failed to map the ring");
+                    return res;
+                }
+
+                int get() const
+                {
+                    return fd;
+                }
+
+            private:
+                int fd;
+            };
+        }
+
+        // the ring is only used by the sides once it is complete, they
+        // check the magic number written last
+        void SharedRing::create(const std::string &name,
+            std::size_t slotCount, std::size_t slotSize)
+        {
+            if(slotCount == 0)
+                throw std::invalid_argument("slot count is 0");
+            if(slotSize == 0)
+                throw std::invalid_argument("slot size is 0");
+            const auto stride = roundUp(SLOT_HEADER + slotSize,
+                SLOT_HEADER);
+            const auto size = slotsOffset() + slotCount*stride;
+            SharedMemory memory(name, O_RDWR | O_CREAT | O_EXCL);
+            if(::ftruncate(memory.get(), static_cast<off_t>(size)) != 0)
+            {
+                const auto error = lastError("failed to size " + name);
+                ::shm_unlink(name.c_str());
+                throw error;
+            }
+            void *const data = memory.map(size);
+            auto *const layout = new(data) Layout();
+            layout->slotCount = slotCount;
+            layout->slotSize = slotSize;
+            layout->stride = stride;
+            std::atomic_thread_fence(std::memory_order_release);
+            layout->magic = MAGIC;
+            ::munmap(data, size);
+        }
+
+        void SharedRing::remove(const std::string &name)
+        {
+            if(::shm_unlink(name.c_str()) != 0 && errno != ENOENT)
+                throw lastError("failed to remove " + name);
+        }
+
+        SharedRing::SharedRing(const std::string &name, Side side)
+            :side(side), mappedSize(0), layout(nullptr), slots(nullptr),
+            pos(0), cached(0), interrupted(false), lost_(false)
+        {
+            SharedMemory memory(name, O_RDWR);
+            struct stat st;
+            if(::fstat(memory.get(), &st) != 0)
+                throw lastError("failed to stat " + name);
+            mappedSize = static_cast<std::size_t>(st.st_size);
+            if(mappedSize < slotsOffset())
+                throw std::runtime_error("not a ring " + name);
+            layout = static_cast<Layout*>(memory.map(mappedSize));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(layout->magic != MAGIC ||
+                slotsOffset() + layout->slotCount*layout->stride > mappedSize)
+            {
+                ::munmap(layout, mappedSize);
+                throw std::runtime_error("not a ring " + name);
+            }
+            slots = reinterpret_cast<char*>(layout) + slotsOffset();
+            if(side == Side::Writer)
+            {
+                pos = layout->tail.load();
+                cached = layout->head.load();
+                layout->writerPid = ::getpid();
+            }
+            else
+            {
+                pos = layout->head.load();
+                cached = layout->tail.load();
+                layout->readerPid = ::getpid();
+            }
+        }
+
+        SharedRing::~SharedRing()
+        {
+            if(side == Side::Writer)
+            {
+                layout->writerClosed = 1;
+                signal(layout->tailSignal);
+            }
+            else
+            {
+                layout->readerClosed = 1;
+                signal(layout->headSignal);
+            }
+            ::munmap(layout, mappedSize);
+        }
+
+        std::size_t SharedRing::slotSize() const
+        {
+            return static_cast<std::size_t>(layout->slotSize);
+        }
+
+        char *SharedRing::slot()
+        {
+            assert(side == Side::Writer);
+            if(pos - cached >= layout->slotCount)
+            {
+                cached = layout->head.load(std::memory_order_acquire);
+                if(pos - cached >= layout->slotCount)
+                    return nullptr;
+            }
+            return slotAt(pos) + SLOT_HEADER;
+        }
+
+        void SharedRing::commit(std::size_t size)
+        {
+            assert(side == Side::Writer);
+            assert(size <= layout->slotSize);
+            const std::uint64_t value = size;
+            std::memcpy(slotAt(pos), &value, sizeof(value));
+            auto &l = *layout;
+            l.tail.store(++pos, std::memory_order_release);
+            // pairs with the one of the reader setting its flag
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(l.readerWaiting.load(std::memory_order_relaxed))
+                signal(l.tailSignal);
+        }
+
+        const char *SharedRing::front(std::size_t &size)
+        {
+            assert(side == Side::Reader);
+            if(pos == cached)
+            {
+                cached = layout->tail.load(std::memory_order_acquire);
+                if(pos == cached)
+                    return nullptr;
+            }
+            const auto *const slot = slotAt(pos);
+            std::uint64_t value = 0;
+            std::memcpy(&value, slot, sizeof(value));
+            size = static_cast<std::size_t>(value);
+            return slot + SLOT_HEADER;
+        }
+
+        void SharedRing::pop()
+        {
+            assert(side == Side::Reader);
+            assert(pos != cached);
+            auto &l = *layout;
+            l.head.store(++pos, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(l.writerWaiting.load(std::memory_order_relaxed))
+                signal(l.headSignal);
+        }
+
+        bool SharedRing::empty() const
+        {
+            return layout->head.load() == layout->tail.load();
+        }
+
+        bool SharedRing::full() const
+        {
+            return layout->tail.load() - layout->head.load() >=
+                layout->slotCount;
+        }
+
+        bool SharedRing::writerClosed() const
+        {
+            return layout->writerClosed.load() != 0;
+        }
+
+        bool SharedRing::readerClosed() const
+        {
+            return layout->readerClosed.load() != 0;
+        }
+
+        bool SharedRing::lost() const
+        {
+            return lost_;
+        }
+
+        void SharedRing::waitNotFull()
+        {
+            assert(side == Side::Writer);
+            auto &l = *layout;
+            while(!interrupted)
+            {
+                if(!full() || l.readerClosed)
+                    return;
+                if(!alive(l.readerPid))
+                {
+                    lost_ = true;
+                    return;
+                }
+                const auto expected = l.headSignal.load();
+                l.writerWaiting = 1;
+                if(full() && !l.readerClosed && !interrupted)
+                    futexWait(l.headSignal, expected);
+                l.writerWaiting = 0;
+            }
+        }
+
+        void SharedRing::waitNotEmpty()
+        {
+            assert(side == Side::Reader);
+            auto &l = *layout;
+            while(!interrupted)
+            {
+                if(!empty() || l.writerClosed)
+                    return;
+                if(!alive(l.writerPid))
+                {
+                    lost_ = true;
+                    return;
+                }
+                const auto expected = l.tailSignal.load();
+                l.readerWaiting = 1;
+                if(empty() && !l.writerClosed && !interrupted)
+                    futexWait(l.tailSignal, expected);
+                l.readerWaiting = 0;
+            }
+        }
+
+        void SharedRing::interrupt()
+        {
+            interrupted = true;
+            signal(side == Side::Writer?layout->headSignal:
+                layout->tailSignal);
+        }
+
+        std::size_t SharedRing::slotsOffset()
+        {
+            return roundUp(sizeof(Layout), LINE);
+        }
+
+        char *SharedRing::slotAt(std::uint64_t pos) const
+        {
+            return slots + (pos%layout->slotCount)*layout->stride;
+        }
+    }
+}
@@ -0,0 +1,139 @@
+#include "xpipe/stage/Tcp.h"
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace xpipe
+{
+    namespace
+    {
+        std::system_error lastError(const std::string &what)
+        {
+            return std::system_error(errno, std::generic_category(), what);
+        }
+    }
+
+    namespace inner
+    {
+        namespace tcp
+        {
+            Socket::Socket(int fd)
+                :fd(fd)
+            {
+                if(fd < 0)
+                    throw std::invalid_argument("socket is not valid");
+            }
+
+            Socket::~Socket()
+            {
+                if(fd >= 0)
+                    ::close(fd);
+            }
+
+            void setNonBlocking(int fd)
+            {
+                const int flags = ::fcntl(fd, F_GETFL);
+                if(flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)
+                    throw lastError("failed to make the socket nonblocking");
+            }
+        }
+    }
+
+    namespace stage
+    {
+        TcpListener::TcpListener(std::uint16_t port,
+            const std::string &address)
+            :fd(-1), port_(0)
+        {
+            const int res = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if(res < 0)
+                throw lastError("failed to create a socket");
+            inner::tcp::Socket socket(res);
+            const int on = 1;
+            ::setsockopt(res, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            if(::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+                throw std::invalid_argument("bad address " + address);
+            if(::bind(res, reinterpret_cast<sockaddr*>(&addr),
+                    sizeof(addr)) != 0)
+                throw lastError("failed to bind " + address);
+            if(::listen(res, SOMAXCONN) != 0)
+                throw lastError("failed to listen");
+            socklen_t len = sizeof(addr);
+            if(::getsockname(res, reinterpret_cast<sockaddr*>(&addr),
+                    &len) != 0)
+                throw lastError("failed to get the port");
+            port_ = ntohs(addr.sin_port);
+            fd = socket.release();
+        }
+
+        TcpListener::~TcpListener()
+        {
+            ::close(fd);
+        }
+
+        int TcpListener::accept()
+        {
+            while(true)
+            {
+                const int res = ::accept4(fd, nullptr, nullptr,
+                    SOCK_CLOEXEC);
+                if(res >= 0)
+                    return res;
+                if(errno != EINTR && errno != ECONNABORTED)
+                    throw lastError("failed to accept");
+            }
+        }
+
+        int tcpConnect(const std::string &host, std::uint16_t port)
+        {
+            addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo *addrs = nullptr;
+            const int res = ::getaddrinfo(host.c_str(),
+                std::to_string(port).c_str(), &hints, &addrs);
+            if(res != 0)
+                throw std::runtime_error("failed to resolve " + host + ": " +
+                    ::gai_strerror(res));
+            int error = 0;
+            for(auto *a = addrs; a; a = a->ai_next)
+            {
+                const int fd = ::socket(a->ai_family,
+                    a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+                if(fd < 0)
+                {
+                    error = errno;
+                    continue;
+                }
+                if(::connect(fd, a->ai_addr, a->ai_addrlen) == 0)
+                {
+                    ::freeaddrinfo(addrs);
+                    // the batches are already as large as they can be
+                    const int on = 1;
+                    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on,
+                        sizeof(on));
+                    return fd;
+                }
+                error = errno;
+                ::close(fd);
+            }
+            ::freeaddrinfo(addrs);
+            errno = error;
+            throw lastError("failed to connect to " + host);
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#include "Tracer.h"
+
+#include <cassert>
+#include <cstdio>
+#include <iomanip>
+
+namespace xpipe
+{
+    Tracer::Tracer(std::size_t workerCount)
+        :origin(Clock::now()), buffers(workerCount + 1), externalMutex()
+    {}
+
+    void Tracer::slice(std::size_t worker, const char *category,
+        const std::string &name, Clock::time_point start,
+        Clock::time_point end)
+    {
+        assert(worker + 1 < buffers.size());
+        buffers[worker].push_back(Event{category, name, start, end - start});
+    }
+
+    void Tracer::instant(std::size_t worker, const char *category,
+        const std::string &name)
+    {
+        assert(worker < buffers.size());
+        const Event event{category, name, Clock::now(),
+            Clock::duration(-1)};
+        if(worker + 1 == buffers.size())
+        {
+            std::lock_guard<std::mutex> lock(externalMutex);
+            buffers[worker].push_back(event);
+        }
+        else
+        {
+            buffers[worker].push_back(event);
+        }
+    }
+
+    void Tracer::write(std::ostream &stream)
+    {
+        std::lock_guard<std::mutex> lock(externalMutex);
+        stream<<std::fixed<<std::setprecision(3);
+        stream<<"{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        for(std::size_t tid = 0; tid < buffers.size(); ++tid)
+        {
+            if(!first)
+                stream<<',';
+            first = false;
+            stream<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                <<"\"tid\":"<<tid<<",\"args\":{\"name\":";
+            writeString(stream, tid + 1 == buffers.size()?
+                std::string("external"):"worker " + std::to_string(tid));
+            stream<<"}}";
+            for(const auto &event : buffers[tid])
+            {
+                stream<<",{\"name\":";
+                writeString(stream, event.name);
+                stream<<",\"cat\":\""<<event.category<<"\",\"pid\":1,"
+                    <<"\"tid\":"<<tid<<",\"ts\":"
+                    <<micros(event.start - origin);
+                if(event.duration < Clock::duration::zero())
+                    stream<<",\"ph\":\"i\",\"s\":\"t\"}";
+                else
+                    stream<<",\"ph\":\"X\",\"dur\":"
+                        <<micros(event.duration)<<'}';
+            }
+            buffers[tid].clear();
+        }
+        stream<<"]}\n";
+    }
+
+    void Tracer::writeString(std::ostream &stream, const std::string &str)
+    {
+        stream<<'"';
+        for(auto c : str)
+        {
+            switch(c)
+            {
+            case '"':
+                stream<<"\\\"";
+                break;
+            case '\\':
+                stream<<"\\\\";
+                break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20)
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    stream<<buf;
+                }
+                else
+                {
+                    stream<<c;
+                }
+            }
+        }
+        stream<<'"';
+    }
+
+    double Tracer::micros(Clock::duration duration) const
+    {
+        return std::chrono::duration_cast<
+            std::chrono::duration<double, std::micro>>(duration).count();
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef XPIPE_TRACER_H
+#define XPIPE_TRACER_H
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace xpipe
+{
+    // scheduler events in the Chrome trace event format, each worker
+    // records into its own buffer, other threads share a locked one
+    class Tracer
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+    public:
+        explicit Tracer(std::size_t workerCount);
+
+        // span on the worker's timeline
+        void slice(std::size_t worker, const char *category,
+            const std::string &name, Clock::time_point start,
+            Clock::time_point end);
+        // event on the worker's timeline, worker count for other threads
+        void instant(std::size_t worker, const char *category,
+            const std::string &name);
+
+        // writes and drops the recorded events, the workers must be idle
+        void write(std::ostream &stream);
+
+        Tracer(const Tracer&) = delete;
+        Tracer &operator=(const Tracer&) = delete;
+
+    private:
+        struct Event
+        {
+            const char *category;
+            std::string name;
+            Clock::time_point start;
+            // negative for instant events
+            Clock::duration duration;
+        };
+        using EventCol = std::vector<Event>;
+
+    private:
+        static void writeString(std::ostream &stream, const std::string &str);
+        double micros(Clock::duration duration) const;
+
+    private:
+        const Clock::time_point origin;
+        std::vector<EventCol> buffers;
+        std::mutex externalMutex;
+    };
+}
+
+#endif
@@ -3,18 +3,45 @@
 #include <vector>
 #include <tuple>
 #include <cstddef>
+#include <cstdint>
 #include <unordered_set>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <numeric>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cmath>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <cppunit/TestCase.h>
 #include <cppunit/extensions/HelperMacros.h>
 
 #include "xpipe/Pipeline.h"
+#include "xpipe/Executor.h"
 #include "xpipe/Runnable.h"
 #include "xpipe/stage/SequenceOf.h"
 #include "xpipe/stage/CopyOf.h"
 #include "xpipe/stage/Delay.h"
+#include "xpipe/stage/Fuse.h"
+#include "xpipe/stage/Kernels.h"
+#include "xpipe/stage/Window.h"
+#include "xpipe/stage/MappedFile.h"
+#include "xpipe/Reactor.h"
+#include "xpipe/stage/SharedRing.h"
+#include "xpipe/stage/Tcp.h"
 
 namespace xpipe
 {
@@ -44,6 +71,39 @@ namespace xpipe
             typename Cont::const_iterator end;
         };
 
+        // runs a runnable owned elsewhere
+        template<typename T>
+        class RunnableRef: public Runnable<T>
+        {
+        public:
+            explicit RunnableRef(Runnable<T> &runnable)
+                :runnable(runnable)
+            {}
+
+            void init(RunnableInlet<T> &inlet) override
+            {
+                runnable.init(inlet);
+            }
+
+            void destroy() override
+            {
+                runnable.destroy();
+            }
+
+            bool canRun() override
+            {
+                return runnable.canRun();
+            }
+
+            bool run() override
+            {
+                return runnable.run();
+            }
+
+        private:
+            Runnable<T> &runnable;
+        };
+
         template<class Cont>
         class ContainerSink
         {
@@ -79,6 +139,28 @@ namespace xpipe
             CPPUNIT_TEST(testCopyOfStage);
             CPPUNIT_TEST(testUseStage);
             CPPUNIT_TEST(testCycle);
+            CPPUNIT_TEST(testWorkStealing);
+            CPPUNIT_TEST(testCapacity);
+            CPPUNIT_TEST(testQueueOverflowOrder);
+            CPPUNIT_TEST(testMoveOnly);
+            CPPUNIT_TEST(testBatchStages);
+            CPPUNIT_TEST(testFuseStage);
+            CPPUNIT_TEST(testSharedExecutor);
+            CPPUNIT_TEST(testRunAsync);
+            CPPUNIT_TEST(testStatistics);
+            CPPUNIT_TEST(testTrace);
+            CPPUNIT_TEST(testParmapOrdered);
+            CPPUNIT_TEST(testParmapFactory);
+            CPPUNIT_TEST(testPartitionBy);
+            CPPUNIT_TEST(testKernelStages);
+            CPPUNIT_TEST(testWindows);
+            CPPUNIT_TEST(testMappedFile);
+            CPPUNIT_TEST(testReactor);
+            CPPUNIT_TEST(testSharedRing);
+            CPPUNIT_TEST(testTcp);
+            CPPUNIT_TEST(testNumaPlacement);
+            CPPUNIT_TEST(testThreadGroups);
+            CPPUNIT_TEST(testWaitStrategies);
             CPPUNIT_TEST_SUITE_END();
 
             using ValCol = std::vector<int>;
@@ -397,6 +479,1203 @@ namespace xpipe
                 Pipeline(f).run();
                 CPPUNIT_ASSERT(act == exp);
             }
+
+            void testWorkStealing()
+            {
+                ValCol values;
+                for(int i = 0; i < 1000; ++i)
+                    values.push_back(i);
+                auto m = [](int v, Inlet<int> &inlet){
+                    inlet.push(v*2);
+                    return true;
+                };
+                ValMultiset exp;
+                for(auto v : values)
+                    exp.insert(v*2);
+                ValMultiset act;
+                auto f =
+                    source(ContainerSource<ValCol>(values))
+                    >>parmap(map(m), map(m), map(m), map(m));
+                anyFrom(f)>>sink(ContainerSink<ValMultiset>(act));
+                PipelineOptions options;
+                options.threadCount = 4;
+                options.scheduling = SchedulingMode::WorkStealing;
+                Pipeline(f, options).run();
+                CPPUNIT_ASSERT(act == exp);
+            }
+
+            void testCapacity()
+            {
+                CPPUNIT_ASSERT(maxInFlight(Capacity::elements(2),
+                        PipelineOptions()) <= 2);
+                CPPUNIT_ASSERT(maxInFlight(Capacity::elements(1),
+                        PipelineOptions()) <= 1);
+                PipelineOptions options;
+                options.capacity = Capacity::sizeofBytes(3*sizeof(int));
+                CPPUNIT_ASSERT(maxInFlight(StageOptions(), options) <= 3);
+                CPPUNIT_ASSERT_THROW(Capacity::elements(0),
+                    std::invalid_argument);
+            }
+
+            void testQueueOverflowOrder()
+            {
+                const int count = 1000;
+                const int fanout = 10;
+                ValCol values;
+                ValCol exp;
+                for(int i = 0; i < count; ++i)
+                {
+                    values.push_back(i);
+                    for(int j = 0; j < fanout; ++j)
+                        exp.push_back(i*fanout + j);
+                }
+                ValCol act;
+                auto f =
+                    source(ContainerSource<ValCol>(values))
+                    >>map([fanout](int v, Inlet<int> &inlet){
+                            for(int j = 0; j < fanout; ++j)
+                                inlet.push(v*fanout + j);
+                            return true;
+                        }, Capacity::elements(2))
+                    >>sink(ContainerSink<ValCol>(act));
+                Pipeline(f).run();
+                CPPUNIT_ASSERT(act == exp);
+            }
+
+            void testMoveOnly()
+            {
+                using Ptr = std::unique_ptr<int>;
+                const int count = 100;
+                auto produce = [](int first){
+                    return [first](Inlet<Ptr> &inlet) mutable{
+                        if(first >= count)
+                            return false;
+                        inlet.push(Ptr(new int(first)));
+                        first += 2;
+                        return true;
+                    };
+                };
+                ValMultiset exp;
+                for(int i = 0; i < count; ++i)
+                    exp.insert(i*2);
+                ValMultiset act;
+                auto f =
+                    any(source(produce(0)), source(produce(1)))
+                    >>map([](Ptr v, Inlet<Ptr> &inlet){
+                            *v *= 2;
+                            inlet.push(std::move(v));
+                            return true;
+                        })
+                    >>sink([&act](Ptr v){
+                            act.insert(*v);
+                            return true;
+                        });
+                Pipeline(f).run();
+                CPPUNIT_ASSERT(act == exp);
+            }
+
+            void testBatchStages()
+            {
+                const std::size_t maxSize = 8;
+                ValCol values;
+                ValCol exp;
+                for(int i = 0; i < 1000; ++i)
+                {
+                    values.push_back(i);
+                    exp.push_back(i*2);
+                }
+                ValCol act;
+                bool sizesValid = true;
+                auto f =
+                    source(ContainerSource<ValCol>(values))
+                    >>batchMap(maxSize,
+                        [&sizesValid, maxSize](ValCol vs, Inlet<int> &inlet){
+                            sizesValid = sizesValid &&
+                                !vs.empty() && vs.size() <= maxSize;
+                            for(auto &v : vs)
+                                v *= 2;
+                            inlet.pushBatch(vs.data(), vs.size());
+                            return true;
+                        })
+                    >>batchSink(maxSize, [&act](const ValCol &vs){
+                            act.insert(std::end(act),
+                                std::begin(vs), std::end(vs));
+                            return true;
+                        });
+                Pipeline(f).run();
+                CPPUNIT_ASSERT(sizesValid);
+                CPPUNIT_ASSERT(act == exp);
+                CPPUNIT_ASSERT_THROW(
+                    batchSink(0, [](const ValCol&){return true;}),
+                    std::invalid_argument);
+            }
+
+            void testFuseStage()
+            {
+                const ValCol values{1, 2, 42, 97, 113};
+                ValCol exp;
+                for(auto v : values)
+                {
+                    exp.push_back(v + 1);
+                    exp.push_back(-v - 1);
+                }
+                ValCol act;
+                auto f =
+                    source(ContainerSource<ValCol>(values))
+                    >>map(stage::fuse(
+                            [](int v, Inlet<long> &inlet){
+                                inlet.push(v + 1);
+                                return true;
+                            },
+                            [](long v, Inlet<long> &inlet){
+                                inlet.push(v);
+                                inlet.push(-v);
+                                return true;
+                            },
+                            [](long v, Inlet<long> &inlet){
+                                inlet.push(v);
+                                return true;
+                            },
+                            [](long v, Inlet<int> &inlet){
+                                inlet.push(static_cast<int>(v));
+                                return true;
+                            }))
+                    >>sink(ContainerSink<ValCol>(act));
+                Pipeline(f).run();
+                CPPUNIT_ASSERT(act == exp);
+
+                const std::size_t limit = 3;
+                ValCol limited;
+                auto g =
+                    source(ContainerSource<ValCol>(values))
+                    >>map(stage::fuse(
+                            [](int v, Inlet<int> &inlet){
+                                inlet.push(v);
+                                return true;
+                            },
+                            [&limited, limit](int v, Inlet<int> &inlet){
+                                limited.push_back(v);
+                                inlet.push(v);
+                                return limited.size() < limit;
+                            }))
+                    >>sink([](int){return true;});
+                Pipeline(g).run();
+                CPPUNIT_ASSERT(limited ==
+                    ValCol(std::begin(values), std::begin(values) + limit));
+            }
+
+            void testSharedExecutor()
+            {
+                const ValCol values{1, 2, 42, 97, 113};
+                ValCol exp;
+                for(auto v : values)
+                    exp.push_back(v*2);
+                PipelineOptions options;
+                options.threadCount = 2;
+                options.executor = std::make_shared<Executor>(2);
+                std::atomic<bool> valid(true);
+                auto runMany = [&](){
+                    for(int i = 0; i < 100; ++i)
+                    {
+                        ValCol act;
+                        auto f =
+                            source(ContainerSource<ValCol>(values))
+                            >>map([](int v, Inlet<int> &inlet){
+                                    inlet.push(v*2);
+                                    return true;
+                                })
+                            >>sink(ContainerSink<ValCol>(act));
+                        Pipeline(f, options).run();
+                        if(act != exp)
+                            valid = false;
+                    }
+                };
+                std::thread other(runMany);
+                runMany();
+                other.join();
+                CPPUNIT_ASSERT(valid);
+                CPPUNIT_ASSERT(options.executor->getThreadCount() == 2);
+                CPPUNIT_ASSERT_THROW(Executor(0), std::invalid_argument);
+            }
+
+            void testRunAsync()
+            {
+                const ValCol values{1, 2, 42, 97, 113};
+                ValCol act;
+                auto f =
+                    source(ContainerSource<ValCol>(values))
+                    >>sink(ContainerSink<ValCol>(act));
+                Pipeline pipeline(f);
+                auto done = pipeline.runAsync();
+                done.get();
+                CPPUNIT_ASSERT(act == values);
+
+                PipelineOptions options;
+                options.threadCount = 1;
+                options.executor = std::make_shared<Executor>(1);
+                std::atomic<bool> started(false);
+                auto endless =
+                    source([&started](Inlet<int> &inlet){
+                            started = true;
+                            inlet.push(0);
+                            return true;
+                        })
+                    >>sink([](int){return true;});
+                Pipeline cancelled(endless, options);
+                auto stopped = cancelled.runAsync();
+                CPPUNIT_ASSERT_THROW(cancelled.runAsync(), std::runtime_error);
+                while(!started)
+                    std::this_thread::yield();
+                cancelled.stop();
+                stopped.get();
+
+                auto failing =
+                    source(ContainerSource<ValCol>(values))
+                    >>sink([](int)->bool{
+                            throw std::runtime_error("sink failed");
+                        });
+                Pipeline failed(failing, 1);
+                auto error = failed.runAsync();
+                CPPUNIT_ASSERT_THROW(error.get(), std::runtime_error);
+                // the next run may start as soon as the result is got
+                failed.runAsync().wait();
+                Pipeline again(f, options);
+                again.runAsync().get();
+                again.runAsync().get();
+
+                // the runs hold no thread while they wait, the reader is
+                // started first on the one thread
+                const std::string name = "/xpipe_test_executor";
+                stage::SharedRing::remove(name);
+                stage::SharedRing::create(name, 4, sizeof(int));
+                ValCol many(1000);
+                std::iota(std::begin(many), std::end(many), 0);
+                ValCol read;
+                Pipeline reader(use(stage::sharedRingInput<int>(name))
+                    >>sink(ContainerSink<ValCol>(read)), options);
+                // the ring is closed with the writer
+                std::unique_ptr<Pipeline> writer(new Pipeline(
+                        source(ContainerSource<ValCol>(many))
+                        >>use(4, stage::sharedRingOutput<int>(name)),
+                        options));
+                auto readDone = reader.runAsync();
+                auto writeDone = writer->runAsync();
+                const std::size_t count = 8;
+                std::vector<ValCol> acts(count);
+                std::vector<std::unique_ptr<Pipeline>> others;
+                std::vector<std::future<void>> othersDone;
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                    others.emplace_back(new Pipeline(
+                            source(ContainerSource<ValCol>(values))
+                            >>sink(ContainerSink<ValCol>(acts[i])),
+                            options));
+                    othersDone.push_back(others.back()->runAsync());
+                }
+                writeDone.get();
+                writer.reset();
+                readDone.get();
+                stage::SharedRing::remove(name);
+                CPPUNIT_ASSERT(read == many);
+                for(std::size_t i = 0; i < count; ++i)
+                {
+                    othersDone[i].get();
+                    CPPUNIT_ASSERT(acts[i] == values);
+                }
+            }
+
+            void testStatistics()
+            {
+                const ValCol values{1, 2, 42, 97, 113};
+                const std::uint64_t count = values.size();
+                ValCol act;
+                auto f =
+                    source(ContainerSource<ValCol>(values),
+                        StageOptions().setName("source"))
+                    >>map([](int v, Inlet<int> &inlet){
+                            inlet.push(v);
+                            inlet.push(v);
+                            return true;
+                        }, StageOptions().setName("twice"))
+                    >>sink(ContainerSink<ValCol>(act),
+                        StageOptions().setName("sink"));
+                CPPUNIT_ASSERT(Pipeline(f).statistics().empty());
+                PipelineOptions options;
+                options.statistics = true;
+                Pipeline pipeline(f, options);
+                pipeline.run();
+                const auto stats = pipeline.statistics();
+                CPPUNIT_ASSERT(stats.size() == 3);
+                std::uint64_t sourceOut = 0;
+                std::uint64_t twiceIn = 0;
+                std::uint64_t twiceOut = 0;
+                std::uint64_t sinkIn = 0;
+                for(const auto &s : stats)
+                {
+                    CPPUNIT_ASSERT(s.runs > 0);
+                    CPPUNIT_ASSERT(s.queueDepth.size() ==
+                        (s.name == "sink"?0u:1u));
+                    if(!s.queueDepth.empty())
+                        CPPUNIT_ASSERT(std::accumulate(
+                                std::begin(s.queueDepth[0]),
+                                std::end(s.queueDepth[0]),
+                                std::uint64_t(0)) == s.valuesOut);
+                    if(s.name == "source")
+                        sourceOut = s.valuesOut;
+                    else if(s.name == "twice")
+                    {
+                        twiceIn = s.valuesIn;
+                        twiceOut = s.valuesOut;
+                    }
+                    else if(s.name == "sink")
+                        sinkIn = s.valuesIn;
+                }
+                CPPUNIT_ASSERT(sourceOut == count);
+                CPPUNIT_ASSERT(twiceIn == count);
+                CPPUNIT_ASSERT(twiceOut == 2*count);
+                CPPUNIT_ASSERT(sinkIn == 2*count);
+
+                // each output queue has its own histogram
+                ValCol left;
+                ValCol right;
+                auto g =
+                    source(ContainerSource<ValCol>(values))
+                    >>multimap([](int v, Inlet<int> &once,
+                            Inlet<int> &twice){
+                            once.push(v);
+                            twice.push(v);
+                            twice.push(v);
+                            return true;
+                        }, StageOptions().setName("split"));
+                g.get<0>()>>sink(ContainerSink<ValCol>(left));
+                g.get<1>()>>sink(ContainerSink<ValCol>(right));
+                Pipeline split(g, options);
+                split.run();
+                bool found = false;
+                for(const auto &s : split.statistics())
+                {
+                    if(s.name != "split")
+                        continue;
+                    found = true;
+                    CPPUNIT_ASSERT(s.queueDepth.size() == 2);
+                    CPPUNIT_ASSERT(std::accumulate(
+                            std::begin(s.queueDepth[0]),
+                            std::end(s.queueDepth[0]),
+                            std::uint64_t(0)) == count);
+                    CPPUNIT_ASSERT(std::accumulate(
+                            std::begin(s.queueDepth[1]),
+                            std::end(s.queueDepth[1]),
+                            std::uint64_t(0)) == 2*count);
+                }
+                CPPUNIT_ASSERT(found);
+                CPPUNIT_ASSERT(right.size() == 2*left.size());
+            }
+
+            void testTrace()
+            {
+                const std::string path = "xpipe_trace_test.json";
+                const ValCol values{1, 2, 42, 97, 113};
+                ValCol act;
+                auto f =
+                    source(ContainerSource<ValCol>(values),
+                        StageOptions().setName("traced \"source\""))
+                    >>sink(ContainerSink<ValCol>(act));
+                PipelineOptions options;
+                options.tracePath = path;
+                Pipeline(f, options).run();
+                CPPUNIT_ASSERT(act == values);
+                std::ifstream stream(path.c_str());
+                std::stringstream trace;
+                trace<<stream.rdbuf();
+                std::remove(path.c_str());
+                const auto str = trace.str();
+                CPPUNIT_ASSERT(str.find("{\"displayTimeUnit\"") == 0);
+                CPPUNIT_ASSERT(str.find("\"cat\":\"run\"") != std::string::npos);
+                CPPUNIT_ASSERT(
+                    str.find("traced \\\"source\\\"") != std::string::npos);
+                CPPUNIT_ASSERT(str.find("\"ph\":\"X\"") != std::string::npos);
+                CPPUNIT_ASSERT(str.find("\"ph\":\"i\"") != std::string::npos);
+                // a trace that can not be written does not hide the failure
+                // of a stage
+                auto failing = source(ContainerSource<ValCol>(values))
+                    >>sink([](int){
+                            throw std::domain_error("stage failed");
+                            return true;
+                        });
+                options.tracePath = "no_such_dir/xpipe_trace_test.json";
+                CPPUNIT_ASSERT_THROW(Pipeline(failing, options).run(),
+                    std::domain_error);
+                act.clear();
+                CPPUNIT_ASSERT_THROW(Pipeline(
+                        source(ContainerSource<ValCol>(values))
+                        >>sink(ContainerSink<ValCol>(act)), options).run(),
+                    std::runtime_error);
+            }
+
+            void testParmapOrdered()
+            {
+                ValCol values;
+                for(int i = 0; i < 1000; ++i)
+                    values.push_back(i);
+                // uneven work and a varying number of outputs per input
+                auto m = [](int v, Inlet<int> &inlet){
+                    if(v%7 == 0)
+                        std::this_thread::yield();
+                    if(v%5 == 0)
+                        return true;
+                    inlet.push(v*2);
+                    if(v%3 == 0)
+                        inlet.push(-v);
+                    return true;
+                };
+                ValCol exp;
+                for(auto v : values)
+                {
+                    if(v%5 == 0)
+                        continue;
+                    exp.push_back(v*2);
+                    if(v%3 == 0)
+                        exp.push_back(-v);
+                }
+                ValCol act;
+                auto f =
+                    source(ContainerSource<ValCol>(values))
+                    >>parmapOrdered(4, m)
+                    >>sink(ContainerSink<ValCol>(act));
+                PipelineOptions options;
+                options.threadCount = 4;
+                options.scheduling = SchedulingMode::WorkStealing;
+                Pipeline(f, options).run();
+                CPPUNIT_ASSERT(act == exp);
+                CPPUNIT_ASSERT_THROW(parmapOrdered(0, m), std::invalid_argument);
+            }
+
+            void testParmapFactory()
+            {
+                ValCol values;
+                for(int i = 0; i < 1000; ++i)
+                    values.push_back(i);
+                ValMultiset exp;
+                for(auto v : values)
+                    exp.insert(v*2);
+                const std::size_t count = 5;
+                std::size_t made = 0;
+                std::vector<int> handled(count, 0);
+                auto factory = [&made, &handled](){
+                    int &replicaHandled = handled[made++];
+                    return map([&replicaHandled](int v, Inlet<int> &inlet){
+                            ++replicaHandled;
+                            inlet.push(v*2);
+                            return true;
+                        });
+                };
+                ValMultiset act;
+                auto f =
+                    source(ContainerSource<ValCol>(values))
+                    >>parmap(count, factory)
+                    >>sink(ContainerSink<ValMultiset>(act));
+                PipelineOptions options;
+                options.threadCount = 3;
+                Pipeline(f, options).run();
+                CPPUNIT_ASSERT(made == count);
+                CPPUNIT_ASSERT(act == exp);
+                CPPUNIT_ASSERT(std::accumulate(std::begin(handled),
+                        std::end(handled), 0) == static_cast<int>(values.size()));
+                CPPUNIT_ASSERT_THROW(parmap(0, factory), std::invalid_argument);
+            }
+
+            void testPartitionBy()
+            {
+                ValCol values;
+                for(int i = 0; i < 1000; ++i)
+                    values.push_back(i);
+                ValMultiset exp(std::begin(values), std::end(values));
+                const std::size_t count = 4;
+                std::size_t made = 0;
+                std::vector<std::unordered_set<int>> keys(count);
+                auto factory = [&made, &keys](){
+                    auto &replicaKeys = keys[made++];
+                    return map([&replicaKeys](int v, Inlet<int> &inlet){
+                            replicaKeys.insert(v%10);
+                            inlet.push(v);
+                            return true;
+                        });
+                };
+                ValMultiset act;
+                auto f =
+                    source(ContainerSource<ValCol>(values))
+                    >>partitionBy([](int v){return v%10;}, count, factory)
+                    >>sink(ContainerSink<ValMultiset>(act));
+                PipelineOptions options;
+                options.threadCount = 3;
+                options.scheduling = SchedulingMode::WorkStealing;
+                Pipeline(f, options).run();
+                CPPUNIT_ASSERT(made == count);
+                CPPUNIT_ASSERT(act == exp);
+                std::size_t keyCount = 0;
+                for(const auto &k : keys)
+                    keyCount += k.size();
+                CPPUNIT_ASSERT(keyCount == 10);
+                CPPUNIT_ASSERT_THROW(
+                    partitionBy([](int v){return v;}, 0, factory),
+                    std::invalid_argument);
+            }
+
+            void testKernelStages()
+            {
+                using Isa = inner::kernels::Isa;
+                using DoubleCol = std::vector<double>;
+                std::vector<std::int32_t> values;
+                for(int i = 0; i < 1003; ++i)
+                    values.push_back(i);
+                DoubleCol exp;
+                double acc = 0;
+                for(auto v : values)
+                {
+                    const double d = 2.0*v + 1.0;
+                    if(v%3 == 0)
+                        continue;
+                    acc += d;
+                    exp.push_back(acc);
+                }
+                const std::size_t maxSize = 37;
+                PipelineOptions options;
+                options.capacity = Capacity::elements(64);
+                for(auto isa : {Isa::Scalar, Isa::Sse2, Isa::Avx2})
+                {
+                    inner::kernels::setIsa(isa);
+                    DoubleCol act;
+                    auto f =
+                        source(ContainerSource<std::vector<std::int32_t>>(values))
+                        >>batchMap(maxSize, stage::Convert<std::int32_t, double>())
+                        >>batchMap(maxSize, stage::Multiply<double>(2.0))
+                        >>batchMap(maxSize, stage::Add<double>(1.0))
+                        >>batchMap(maxSize, stage::filter<double>([](double v){
+                                    return static_cast<int>(v)%6 != 1;
+                                }))
+                        >>batchMap(maxSize, stage::PrefixSum<double>())
+                        >>batchMap(maxSize, stage::Convert<double, float>())
+                        >>batchMap(maxSize, stage::Convert<float, double>())
+                        >>sink(ContainerSink<DoubleCol>(act));
+                    Pipeline(f, options).run();
+                    CPPUNIT_ASSERT(act == exp);
+
+                    DoubleCol sums;
+                    DoubleCol mins;
+                    DoubleCol maxs;
+                    auto g =
+                        source(ContainerSource<DoubleCol>(exp))
+                        >>multimap(stage::CopyOf<double, 3>());
+                    g.get<0>()>>batchMap(maxSize, stage::Sum<double>())
+                        >>sink(ContainerSink<DoubleCol>(sums));
+                    g.get<1>()>>batchMap(maxSize, stage::Min<double>())
+                        >>sink(ContainerSink<DoubleCol>(mins));
+                    g.get<2>()>>batchMap(maxSize, stage::Max<double>())
+                        >>sink(ContainerSink<DoubleCol>(maxs));
+                    Pipeline(g, options).run();
+                    // the values are whole so the sums are exact
+                    CPPUNIT_ASSERT((sums == DoubleCol{std::accumulate(
+                                    std::begin(exp), std::end(exp), 0.0)}));
+                    CPPUNIT_ASSERT((mins == DoubleCol{exp.front()}));
+                    CPPUNIT_ASSERT((maxs == DoubleCol{exp.back()}));
+
+                    // the same sum whatever the batches
+                    DoubleCol fractions;
+                    for(int i = 0; i < 1003; ++i)
+                        fractions.push_back(0.1*i);
+                    DoubleCol bySize[2];
+                    const std::size_t sizes[2] = {1, maxSize};
+                    for(int i = 0; i < 2; ++i)
+                    {
+                        auto h = source(ContainerSource<DoubleCol>(fractions))
+                            >>batchMap(sizes[i], stage::Sum<double>(16))
+                            >>sink(ContainerSink<DoubleCol>(bySize[i]));
+                        Pipeline(h, options).run();
+                    }
+                    CPPUNIT_ASSERT(bySize[0].size() == 1);
+                    CPPUNIT_ASSERT(bySize[0] == bySize[1]);
+                }
+                inner::kernels::setIsa(inner::kernels::supportedIsa());
+                const DoubleCol noValues;
+                DoubleCol none;
+                auto empty = source(ContainerSource<DoubleCol>(noValues))
+                    >>batchMap(maxSize, stage::Max<double>())
+                    >>sink(ContainerSink<DoubleCol>(none));
+                Pipeline(empty).run();
+                CPPUNIT_ASSERT(none.empty());
+                CPPUNIT_ASSERT_THROW(stage::Sum<double>(0),
+                    std::invalid_argument);
+            }
+
+            void testWindows()
+            {
+                namespace aggregate = stage::aggregate;
+                using Ticks = std::chrono::milliseconds;
+                using Timed = std::pair<Ticks, int>;
+                using TimedCol = std::vector<Timed>;
+                using TimedDoubleCol = std::vector<std::pair<Ticks, double>>;
+                using DoubleCol = std::vector<double>;
+                const ValCol values{5, 1, 4, 2, 8, 7, 3, 6, 9};
+                ValCol sums;
+                ValCol maxs;
+                ValCol mins;
+                DoubleCol means;
+                auto f =
+                    source(ContainerSource<ValCol>(values))
+                    >>multimap(stage::CopyOf<int, 4>());
+                f.get<0>()>>map(stage::CountWindow<int, aggregate::Sum<int>>(
+                        2))>>sink(ContainerSink<ValCol>(sums));
+                f.get<1>()>>map(stage::CountWindow<int, aggregate::Max<int>>(
+                        3, 1))>>sink(ContainerSink<ValCol>(maxs));
+                f.get<2>()>>map(stage::CountWindow<int, aggregate::Min<int>>(
+                        4, 2))>>sink(ContainerSink<ValCol>(mins));
+                f.get<3>()>>map(stage::CountWindow<int, aggregate::Mean<int>>(
+                        2, 3))>>sink(ContainerSink<DoubleCol>(means));
+                Pipeline(f).run();
+                CPPUNIT_ASSERT((sums == ValCol{6, 6, 15, 9}));
+                CPPUNIT_ASSERT((maxs == ValCol{5, 4, 8, 8, 8, 7, 9}));
+                CPPUNIT_ASSERT((mins == ValCol{1, 2, 3}));
+                CPPUNIT_ASSERT((means == DoubleCol{3.0, 5.0, 4.5}));
+
+                const TimedCol timed{{Ticks(0), 1}, {Ticks(3), 3},
+                    {Ticks(10), 2}, {Ticks(12), 6}, {Ticks(35), 4},
+                    {Ticks(38), 8}, {Ticks(41), 0}};
+                std::vector<std::pair<Ticks, int>> tumbling;
+                TimedDoubleCol sliding;
+                auto g =
+                    source(ContainerSource<TimedCol>(timed))
+                    >>multimap(stage::CopyOf<Timed, 2>());
+                g.get<0>()>>map(stage::TimeWindow<int, aggregate::Sum<int>,
+                        Ticks>(Ticks(10)))
+                    >>sink(ContainerSink<TimedCol>(tumbling));
+                g.get<1>()>>map(stage::TimeWindow<int,
+                        aggregate::Variance<int>, Ticks>(Ticks(20), Ticks(10)))
+                    >>sink(ContainerSink<TimedDoubleCol>(sliding));
+                Pipeline(g).run();
+                CPPUNIT_ASSERT((tumbling == TimedCol{{Ticks(10), 4},
+                            {Ticks(20), 8}, {Ticks(40), 12}}));
+                const TimedDoubleCol exp{{Ticks(10), 1.0}, {Ticks(20), 3.5},
+                    {Ticks(30), 4.0}, {Ticks(40), 4.0}};
+                CPPUNIT_ASSERT(sliding.size() == exp.size());
+                for(std::size_t i = 0; i < exp.size(); ++i)
+                {
+                    CPPUNIT_ASSERT(sliding[i].first == exp[i].first);
+                    CPPUNIT_ASSERT(
+                        std::fabs(sliding[i].second - exp[i].second) < 1e-9);
+                }
+
+                CPPUNIT_ASSERT_THROW(
+                    (stage::CountWindow<int, aggregate::Sum<int>>(0)),
+                    std::invalid_argument);
+            }
+
+            void testMappedFile()
+            {
+                using StringCol = std::vector<std::string>;
+                const std::string path = "xpipe_mapped_test.txt";
+                {
+                    std::ofstream stream(path.c_str());
+                    stream<<"first\nsecond\n\nthird line\nlast";
+                }
+                auto collect = [](StringCol &col){
+                    return sink([&col](stage::Span span){
+                            col.push_back(span.str());
+                            return true;
+                        });
+                };
+                StringCol lines;
+                auto f = source(stage::mappedLines(path, '\n', 2))
+                    >>collect(lines);
+                Pipeline(f).run();
+                CPPUNIT_ASSERT((lines ==
+                        StringCol{"first", "second", "", "third line", "last"}));
+
+                StringCol records;
+                auto g = source(stage::mappedRecords(path, 8))
+                    >>collect(records);
+                Pipeline(g).run();
+                CPPUNIT_ASSERT((records == StringCol{"first\nse", "cond\n\nth",
+                            "ird line", "\nlast"}));
+
+                StringCol chunks;
+                auto h = source(stage::mappedChunks(path, 9))
+                    >>collect(chunks);
+                Pipeline(h).run();
+                CPPUNIT_ASSERT((chunks == StringCol{"first\nsecond\n",
+                            "\nthird line\n", "last"}));
+                std::remove(path.c_str());
+
+                {
+                    std::ofstream stream(path.c_str());
+                }
+                StringCol empty;
+                auto e = source(stage::mappedLines(path))>>collect(empty);
+                Pipeline(e).run();
+                std::remove(path.c_str());
+                CPPUNIT_ASSERT(empty.empty());
+                CPPUNIT_ASSERT_THROW(stage::mappedLines(path),
+                    std::system_error);
+            }
+
+            void testReactor()
+            {
+                using Buffer = std::vector<char>;
+                std::string data;
+                for(int i = 0; i < 20000; ++i)
+                    data += std::to_string(i) + ' ';
+                const std::string path = "xpipe_reactor_test.txt";
+                {
+                    std::ofstream stream(path.c_str());
+                    stream<<data;
+                }
+                auto readAll = [](Reactor &reactor, int fd){
+                    std::string res;
+                    auto f = use(std::unique_ptr<Runnable<Buffer>>(
+                            new ReadRunnable(reactor, fd, 4096, 2)))
+                        >>sink([&res](const Buffer &buffer){
+                                res.append(buffer.data(), buffer.size());
+                                return true;
+                            });
+                    Pipeline(f).run();
+                    return res;
+                };
+                for(auto backend : {Reactor::Backend::Auto,
+                        Reactor::Backend::Epoll})
+                {
+                    Reactor reactor(backend);
+                    int fds[2];
+                    CPPUNIT_ASSERT(::pipe(fds) == 0);
+                    std::thread writer([&data, &fds](){
+                            for(std::size_t pos = 0; pos < data.size();
+                                pos += 1000)
+                            {
+                                const auto size =
+                                    std::min<std::size_t>(1000,
+                                        data.size() - pos);
+                                CPPUNIT_ASSERT(::write(fds[1],
+                                        data.data() + pos, size) ==
+                                    static_cast<ssize_t>(size));
+                            }
+                            ::close(fds[1]);
+                        });
+                    CPPUNIT_ASSERT(readAll(reactor, fds[0]) == data);
+                    writer.join();
+                    ::close(fds[0]);
+
+                    const int fd = ::open(path.c_str(), O_RDONLY);
+                    CPPUNIT_ASSERT(fd >= 0);
+                    CPPUNIT_ASSERT(readAll(reactor, fd) == data);
+                    ::close(fd);
+
+                    // the read still waiting for data is cancelled
+                    int pair[2];
+                    CPPUNIT_ASSERT(
+                        ::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+                    // the cancellation in a run does not reach the read
+                    // of the next run of the runnable
+                    ReadRunnable reader(reactor, pair[0]);
+                    for(int i = 0; i < 50; ++i)
+                    {
+                        CPPUNIT_ASSERT(::write(pair[1], "abc", 3) == 3);
+                        std::string first;
+                        auto f = use(std::unique_ptr<Runnable<Buffer>>(
+                                new RunnableRef<Buffer>(reader)))
+                            >>sink([&first](const Buffer &buffer){
+                                    first.assign(buffer.data(),
+                                        buffer.size());
+                                    return false;
+                                });
+                        Pipeline(f).run();
+                        CPPUNIT_ASSERT(first == "abc");
+                    }
+                    ::close(pair[0]);
+                    ::close(pair[1]);
+                }
+                std::remove(path.c_str());
+            }
+
+            void testSharedRing()
+            {
+                const std::string name = "/xpipe_ring_test";
+                ValCol values(1000);
+                std::iota(std::begin(values), std::end(values), 0);
+                stage::SharedRing::remove(name);
+                stage::SharedRing::create(name, 8, sizeof(int));
+                const auto child = ::fork();
+                CPPUNIT_ASSERT(child >= 0);
+                if(child == 0)
+                {
+                    int res = 0;
+                    try
+                    {
+                        auto f = source(ContainerSource<ValCol>(values))
+                            >>use(64, stage::sharedRingOutput<int>(name));
+                        Pipeline(f).run();
+                    }
+                    catch(...)
+                    {
+                        res = 1;
+                    }
+                    ::_exit(res);
+                }
+                ValCol act;
+                {
+                    auto f = use(stage::sharedRingInput<int>(name))
+                        >>sink(ContainerSink<ValCol>(act));
+                    Pipeline(f).run();
+                }
+                int status = 0;
+                CPPUNIT_ASSERT(::waitpid(child, &status, 0) == child);
+                stage::SharedRing::remove(name);
+                CPPUNIT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+                CPPUNIT_ASSERT(act == values);
+
+                // the writer stops once the reader is closed
+                stage::SharedRing::create(name, 4, 16);
+                std::size_t written = 0;
+                std::thread writer([&name, &written](){
+                        auto f = source([&written](Inlet<std::string> &inlet){
+                                inlet.push(std::to_string(written++));
+                                return true;
+                            })
+                            >>use(64,
+                                stage::sharedRingOutput<std::string>(name,
+                                    stage::StringCodec()));
+                        Pipeline(f).run();
+                    });
+                std::vector<std::string> read;
+                {
+                    auto f = use(stage::sharedRingInput<std::string>(name,
+                            stage::StringCodec()))
+                        >>sink([&read](std::string v){
+                                read.push_back(std::move(v));
+                                return read.size() < 100;
+                            });
+                    Pipeline(f).run();
+                }
+                writer.join();
+                stage::SharedRing::remove(name);
+                CPPUNIT_ASSERT(read.size() == 100);
+                for(std::size_t i = 0; i < read.size(); ++i)
+                    CPPUNIT_ASSERT(read[i] == std::to_string(i));
+                CPPUNIT_ASSERT_THROW(
+                    stage::SharedRing(name, stage::SharedRing::Side::Reader),
+                    std::system_error);
+
+                // a writer ending without closing the ring fails the reader
+                stage::SharedRing::create(name, 8, sizeof(int));
+                const auto lostChild = ::fork();
+                CPPUNIT_ASSERT(lostChild >= 0);
+                if(lostChild == 0)
+                {
+                    stage::SharedRing ring(name,
+                        stage::SharedRing::Side::Writer);
+                    const int value = 42;
+                    std::memcpy(ring.slot(), &value, sizeof(value));
+                    ring.commit(sizeof(value));
+                    ::_exit(0);
+                }
+                // the reader only sees the writer gone once it is reaped,
+                // which waits for the value to get through the pipeline
+                std::mutex lostMutex;
+                std::condition_variable lostCond;
+                ValCol lostAct;
+                int lostStatus = 0;
+                std::thread reaper([&, lostChild](){
+                        {
+                            std::unique_lock<std::mutex> lock(lostMutex);
+                            lostCond.wait_for(lock, std::chrono::seconds(10),
+                                [&lostAct](){return !lostAct.empty();});
+                        }
+                        ::waitpid(lostChild, &lostStatus, 0);
+                    });
+                auto lost = use(stage::sharedRingInput<int>(name))
+                    >>sink([&](int v){
+                            std::lock_guard<std::mutex> lock(lostMutex);
+                            lostAct.push_back(v);
+                            lostCond.notify_all();
+                            return true;
+                        });
+                CPPUNIT_ASSERT_THROW(Pipeline(lost).run(),
+                    std::runtime_error);
+                reaper.join();
+                stage::SharedRing::remove(name);
+                CPPUNIT_ASSERT(lostAct == ValCol{42});
+
+                // the slots have to hold the values written to them
+                stage::SharedRing::create(name, 4, sizeof(int) - 1);
+                CPPUNIT_ASSERT_THROW(stage::sharedRingInput<int>(name),
+                    std::invalid_argument);
+                CPPUNIT_ASSERT_THROW(stage::sharedRingOutput<int>(name),
+                    std::invalid_argument);
+                stage::SharedRing::remove(name);
+                stage::SharedRing::create(name, 4, 16);
+                {
+                    stage::SharedRing ring(name,
+                        stage::SharedRing::Side::Writer);
+                    std::memset(ring.slot(), 0, sizeof(short));
+                    ring.commit(sizeof(short));
+                }
+                ValCol shortAct;
+                auto shortSlot = use(stage::sharedRingInput<int>(name))
+                    >>sink(ContainerSink<ValCol>(shortAct));
+                CPPUNIT_ASSERT_THROW(Pipeline(shortSlot).run(),
+                    std::runtime_error);
+                stage::SharedRing::remove(name);
+                CPPUNIT_ASSERT(shortAct.empty());
+            }
+
+            void testTcp()
+            {
+                using StringCol = std::vector<std::string>;
+                // more than the socket buffers hold
+                ValCol values(300000);
+                std::iota(std::begin(values), std::end(values), 0);
+                StringCol strings;
+                for(int i = 0; i < 1000; ++i)
+                    strings.push_back(std::string(i%7, 'a') +
+                        std::to_string(i));
+                stage::TcpListener listener(0, "127.0.0.1");
+                Reactor reactor;
+                std::thread sender([&](){
+                        auto f = source(ContainerSource<ValCol>(values))
+                            >>use(100, stage::tcpOutput<int>(reactor,
+                                    stage::tcpConnect("localhost",
+                                        listener.port())));
+                        Pipeline(f).run();
+                        auto g = source(ContainerSource<StringCol>(strings))
+                            >>use(64, stage::tcpOutput<std::string>(reactor,
+                                    stage::tcpConnect("127.0.0.1",
+                                        listener.port()),
+                                    stage::StringCodec()));
+                        Pipeline(g).run();
+                    });
+                ValCol act;
+                const int fd = listener.accept();
+                {
+                    auto f = stage::tcpInput<int>(reactor, fd)
+                        >>sink(ContainerSink<ValCol>(act));
+                    Pipeline(f).run();
+                }
+                ::close(fd);
+                StringCol actStrings;
+                const int stringFd = listener.accept();
+                {
+                    auto f = stage::tcpInput<std::string>(reactor, stringFd,
+                            stage::StringCodec())
+                        >>sink(ContainerSink<StringCol>(actStrings));
+                    Pipeline(f).run();
+                }
+                ::close(stringFd);
+                sender.join();
+                CPPUNIT_ASSERT(act == values);
+                CPPUNIT_ASSERT(actStrings == strings);
+
+                // frames larger than the socket buffers are sent in parts
+                {
+                    Reactor epoll(Reactor::Backend::Epoll);
+                    std::thread bigSender([&](){
+                            auto f = source(ContainerSource<ValCol>(values))
+                                >>use(values.size(), stage::tcpOutput<int>(
+                                        epoll, stage::tcpConnect("127.0.0.1",
+                                            listener.port())));
+                            Pipeline(f).run();
+                        });
+                    ValCol bigAct;
+                    const int bigFd = listener.accept();
+                    {
+                        auto f = stage::tcpInput<int>(epoll, bigFd)
+                            >>sink(ContainerSink<ValCol>(bigAct));
+                        Pipeline(f).run();
+                    }
+                    ::close(bigFd);
+                    bigSender.join();
+                    CPPUNIT_ASSERT(bigAct == values);
+                }
+
+                // frames of the wrong size and a frame cut short
+                auto receive = [&reactor](std::uint32_t elemSize,
+                    std::size_t sent){
+                    int pair[2];
+                    CPPUNIT_ASSERT(
+                        ::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+                    char frame[inner::tcp::HEADER_SIZE + 8] = {};
+                    inner::tcp::putUint32(frame, 2);
+                    inner::tcp::putUint32(frame + 4, 2*elemSize);
+                    inner::tcp::putUint32(frame + 8, elemSize);
+                    CPPUNIT_ASSERT(::write(pair[1], frame, sent) ==
+                        static_cast<ssize_t>(sent));
+                    ::close(pair[1]);
+                    ValCol res;
+                    auto f = stage::tcpInput<int>(reactor, pair[0])
+                        >>sink(ContainerSink<ValCol>(res));
+                    try
+                    {
+                        Pipeline(f).run();
+                    }
+                    catch(...)
+                    {
+                        ::close(pair[0]);
+                        throw;
+                    }
+                    ::close(pair[0]);
+                };
+                receive(sizeof(int), inner::tcp::HEADER_SIZE + 8);
+                CPPUNIT_ASSERT_THROW(receive(2, inner::tcp::HEADER_SIZE + 4),
+                    std::runtime_error);
+                CPPUNIT_ASSERT_THROW(
+                    receive(sizeof(int), inner::tcp::HEADER_SIZE + 6),
+                    std::runtime_error);
+            }
+
+            void testNumaPlacement()
+            {
+                const ValCol values{1, 2, 42, 97, 113};
+                cpu_set_t before;
+                CPPUNIT_ASSERT(::sched_getaffinity(0, sizeof(before),
+                        &before) == 0);
+                std::atomic<bool> pinned(true);
+                ValCol act;
+                auto f =
+                    source(ContainerSource<ValCol>(values))
+                    >>map([&pinned](int v, Inlet<int> &inlet){
+                            cpu_set_t cpus;
+                            if(::sched_getaffinity(0, sizeof(cpus),
+                                    &cpus) != 0 || CPU_COUNT(&cpus) != 1)
+                                pinned = false;
+                            inlet.push(v);
+                            return true;
+                        }, StageOptions().setNode(0))
+                    // no workers there, it runs anywhere
+                    >>map([](int v, Inlet<int> &inlet){
+                            inlet.push(v);
+                            return true;
+                        }, StageOptions().setNode(1000))
+                    >>sink(ContainerSink<ValCol>(act));
+                PipelineOptions options;
+                options.threadCount = 3;
+                options.pinWorkers = true;
+                Pipeline(f, options).run();
+                CPPUNIT_ASSERT(act == values);
+                CPPUNIT_ASSERT(pinned);
+                cpu_set_t after;
+                CPPUNIT_ASSERT(::sched_getaffinity(0, sizeof(after),
+                        &after) == 0);
+                CPPUNIT_ASSERT(CPU_EQUAL(&before, &after));
+            }
+
+            void testThreadGroups()
+            {
+                using IdSet = std::unordered_set<std::thread::id>;
+                const ValCol values{1, 2, 42, 97, 113};
+                std::mutex mutex;
+                IdSet sourceIds;
+                IdSet bulkIds;
+                IdSet sinkIds;
+                auto record = [&mutex](IdSet &ids){
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ids.insert(std::this_thread::get_id());
+                };
+                ValCol act;
+                auto it = std::begin(values);
+                auto f =
+                    source([&](Inlet<int> &inlet){
+                            record(sourceIds);
+                            if(it == std::end(values))
+                                return false;
+                            inlet.push(*it++);
+                            return true;
+                        })
+                    >>map([&](int v, Inlet<int> &inlet){
+                            record(bulkIds);
+                            inlet.push(v);
+                            return true;
+                        }, StageOptions().setThreadGroup("bulk"))
+                    >>sink([&](int v){
+                            record(sinkIds);
+                            act.push_back(v);
+                            return true;
+                        }, StageOptions().setDedicatedThread());
+                PipelineOptions options;
+                options.threadCount = 2;
+                CPPUNIT_ASSERT_THROW(Pipeline(f, options),
+                    std::invalid_argument);
+                options.threadGroups["bulk"] = 2;
+                Pipeline(f, options).run();
+                CPPUNIT_ASSERT(act == values);
+                CPPUNIT_ASSERT(sinkIds.size() == 1);
+                CPPUNIT_ASSERT(bulkIds.count(std::this_thread::get_id()) == 0);
+                for(const auto &id : sourceIds)
+                {
+                    CPPUNIT_ASSERT(bulkIds.count(id) == 0);
+                    CPPUNIT_ASSERT(sinkIds.count(id) == 0);
+                }
+                for(const auto &id : bulkIds)
+                    CPPUNIT_ASSERT(sinkIds.count(id) == 0);
+            }
+
+            void testWaitStrategies()
+            {
+                ValCol values(200);
+                std::iota(std::begin(values), std::end(values), 0);
+                for(const auto waiting : {WaitStrategy::Blocking,
+                        WaitStrategy::BusySpin, WaitStrategy::SpinYield,
+                        WaitStrategy::SpinPark})
+                {
+                    ValCol act;
+                    std::size_t pos = 0;
+                    // bursts with pauses long enough for the workers to
+                    // run out of spins
+                    auto f =
+                        source([&values, &pos](Inlet<int> &inlet){
+                                if(pos == values.size())
+                                    return false;
+                                if(pos%50 == 49)
+                                    std::this_thread::sleep_for(
+                                        std::chrono::milliseconds(2));
+                                inlet.push(values[pos++]);
+                                return true;
+                            })
+                        >>map([](int v, Inlet<int> &inlet){
+                                inlet.push(v);
+                                return true;
+                            })
+                        >>sink(ContainerSink<ValCol>(act),
+                            StageOptions().setDedicatedThread());
+                    PipelineOptions options;
+                    options.threadCount = 2;
+                    options.waiting = waiting;
+                    Pipeline(f, options).run();
+                    CPPUNIT_ASSERT(act == values);
+                }
+            }
+
+        private:
+            static int maxInFlight(const StageOptions &stageOptions,
+                const PipelineOptions &options)
+            {
+                const int count = 100;
+                std::atomic<int> consumed(0);
+                int produced = 0;
+                int res = 0;
+                ValCol act;
+                auto f =
+                    source([&](Inlet<int> &inlet){
+                            if(produced == count)
+                                return false;
+                            res = std::max(res, produced - consumed.load());
+                            inlet.push(produced++);
+                            return true;
+                        }, stageOptions)
+                    >>sink([&](int v){
+                            act.push_back(v);
+                            ++consumed;
+                            return true;
+                        });
+                Pipeline(f, options).run();
+                CPPUNIT_ASSERT(act.size() == static_cast<std::size_t>(count));
+                return res;
+            }
         };
         CPPUNIT_TEST_SUITE_REGISTRATION(PipelineTest);
     }